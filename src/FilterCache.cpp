@@ -0,0 +1,148 @@
+/**     @file FilterCache.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ */
+
+#include "FilterCache.h"
+
+#include <functional>
+
+namespace
+{
+    void combine(std::size_t &seed, std::size_t value)
+    {
+        seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+    }
+
+    /* A polydata of its own that shares the arrays of a cached mesh */
+    vtkSmartPointer<vtkPolyData> view(vtkPolyData *mesh)
+    {
+        vtkSmartPointer<vtkPolyData> copy = vtkSmartPointer<vtkPolyData>::New();
+        copy->ShallowCopy(mesh);
+        return copy;
+    }
+}
+
+/* Enough for a handful of filtered copies of a large assembly */
+FilterCache::FilterCache() : bytesUsed(0), memoryLimit(qint64(512) << 20), hits(0), misses(0)
+{
+}
+
+FilterCache &FilterCache::instance()
+{
+    static FilterCache cache;
+    return cache;
+}
+
+std::size_t FilterCache::KeyHash::operator()(const FilterKey &key) const
+{
+    std::size_t seed = std::size_t(key.geometry.contentHash ^ quint64(key.geometry.fileSize) * 0x9e3779b97f4a7c15ULL);
+    combine(seed, std::hash<double>()(key.geometry.weldTolerance));
+    for (const PartFilter &filter : key.filters)
+    {
+        combine(seed, std::size_t(filter.type));
+        for (double parameter : filter.parameters)
+            combine(seed, std::hash<double>()(parameter));
+    }
+    return seed;
+}
+
+vtkSmartPointer<vtkPolyData> FilterCache::find(const FilterKey &key, std::size_t &stages)
+{
+    QMutexLocker locker(&mutex);
+
+    /* Try the whole stack first, then shorter and shorter runs of it */
+    FilterKey prefix = key;
+    for (stages = key.filters.size(); stages > 0; stages--)
+    {
+        prefix.filters.resize(stages);
+        auto it = entries.find(prefix);
+        if (it == entries.end())
+            continue;
+
+        hits += qint64(stages);
+        misses += qint64(key.filters.size() - stages);
+        recent.splice(recent.begin(), recent, it->second);
+        return view(it->second->output);
+    }
+
+    misses += qint64(key.filters.size());
+    return nullptr;
+}
+
+void FilterCache::insert(const FilterKey &key, vtkSmartPointer<vtkPolyData> output)
+{
+    if (!key.geometry.isValid() || output == nullptr)
+        return;
+
+    /* Computing the bounds caches them in the points, after this GetBounds() only reads */
+    output->GetBounds();
+    qint64 bytes = qint64(output->GetActualMemorySize()) * 1024;
+
+    QMutexLocker locker(&mutex);
+
+    /* Another worker may have run the same filter */
+    if (entries.count(key) > 0)
+        return;
+
+    Entry entry;
+    entry.key = key;
+    entry.output = output;
+    entry.bytes = bytes;
+    recent.push_front(entry);
+    entries[key] = recent.begin();
+    bytesUsed += bytes;
+
+    trim();
+}
+
+void FilterCache::clear()
+{
+    QMutexLocker locker(&mutex);
+    entries.clear();
+    recent.clear();
+    bytesUsed = 0;
+}
+
+void FilterCache::setMemoryLimit(qint64 bytes)
+{
+    QMutexLocker locker(&mutex);
+    memoryLimit = bytes;
+    trim();
+}
+
+void FilterCache::trim()
+{
+    /* Dropping an entry only releases the cache's reference, actors still showing the mesh keep it */
+    while (bytesUsed > memoryLimit && !recent.empty())
+    {
+        bytesUsed -= recent.back().bytes;
+        entries.erase(recent.back().key);
+        recent.pop_back();
+    }
+}
+
+qint64 FilterCache::memoryUsed()
+{
+    QMutexLocker locker(&mutex);
+    return bytesUsed;
+}
+
+int FilterCache::entryCount()
+{
+    QMutexLocker locker(&mutex);
+    return int(entries.size());
+}
+
+qint64 FilterCache::hitCount()
+{
+    QMutexLocker locker(&mutex);
+    return hits;
+}
+
+qint64 FilterCache::missCount()
+{
+    QMutexLocker locker(&mutex);
+    return misses;
+}
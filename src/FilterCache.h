@@ -0,0 +1,148 @@
+/**     @file FilterCache.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief Process-wide cache of filtered meshes so re-applying a filter doesn't run it again
+ */
+
+#ifndef VIEWER_FILTERCACHE_H
+#define VIEWER_FILTERCACHE_H
+
+#include "PartMesh.h"
+#include "PartFilter.h"
+
+#include <QMutex>
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Identifies a filtered mesh by the mesh it came from and the filters run on it, in order
+ */
+struct FilterKey
+{
+  GeometryKey geometry;            /**< Key of the unfiltered mesh */
+  std::vector<PartFilter> filters; /**< Filters applied to it, first to last */
+
+  /** Compare two keys
+   * @param other is the key to compare with
+   * @return true if both keys refer to the same filtered mesh
+   */
+  bool operator==(const FilterKey &other) const
+  {
+    return geometry == other.geometry && filters == other.filters;
+  }
+};
+
+/**
+ * @class FilterCache
+ * @brief Keeps the outputs of recent filters, up to a memory limit
+ *
+ * Filtered meshes are keyed by the content key of the part's mesh plus the filters and their parameters,
+ * so every part showing the same file shares one result, and toggling between views of a part only runs
+ * each filter once. The output of every stage of a filter stack is cached under the filters up to it,
+ * so editing a stage only reruns the stages from there on. When the cached meshes use more than the limit the least recently used ones are
+ * dropped. All functions are thread safe.
+ *
+ * Cached meshes are never handed out directly, find() returns a view of its own that shares the arrays,
+ * so the renderers and later filters never touch the same data object.
+ */
+class FilterCache
+{
+public:
+    /**
+     * @brief Get the cache
+     * @return the process-wide instance
+     */
+    static FilterCache &instance();
+
+    /**
+     * @brief Look up the longest run of a key's filters, from the first, that has been cached
+     * @param key The mesh and filters
+     * @param stages Receives the number of filters in the run found, 0 if none
+     * @return a view of the cached mesh, nullptr if there isn't one
+     */
+    vtkSmartPointer<vtkPolyData> find(const FilterKey &key, std::size_t &stages);
+
+    /**
+     * @brief Add a filtered mesh, dropping older ones if the cache is over its limit
+     * @param key The mesh and filters, the result isn't kept if its geometry key isn't valid
+     * @param output The filter's output, which must not be used again except through find()
+     */
+    void insert(const FilterKey &key, vtkSmartPointer<vtkPolyData> output);
+
+    /**
+     * @brief Drop every cached mesh
+     */
+    void clear();
+
+    /**
+     * @brief Set how much memory the cached meshes may use
+     * @param bytes The limit in bytes
+     */
+    void setMemoryLimit(qint64 bytes);
+
+    /**
+     * @brief Get how much memory the cached meshes use
+     * @return size in bytes
+     */
+    qint64 memoryUsed();
+
+    /**
+     * @brief Get the number of meshes in the cache
+     * @return number of cached meshes
+     */
+    int entryCount();
+
+    /**
+     * @brief Get the number of filter stages found in the cache
+     * @return number of stages that didn't need running
+     */
+    qint64 hitCount();
+
+    /**
+     * @brief Get the number of filter stages that weren't in the cache
+     * @return number of stages that had to be run
+     */
+    qint64 missCount();
+
+private:
+    /**
+     * @brief Constructor, use instance()
+     */
+    FilterCache();
+
+    /**
+     * @brief Drop the least recently used meshes until the cache is within its limit (mutex must be held)
+     */
+    void trim();
+
+    /**
+     * @brief Hash function for the key map
+     */
+    struct KeyHash
+    {
+        std::size_t operator()(const FilterKey &key) const;
+    };
+
+    /**
+     * @brief A cached mesh and its size
+     */
+    struct Entry
+    {
+        FilterKey key;
+        vtkSmartPointer<vtkPolyData> output;
+        qint64 bytes = 0;
+    };
+
+    QMutex mutex;                                                                   /**< Guards everything below */
+    std::list<Entry> recent;                                                        /**< Cached meshes, most recently used first */
+    std::unordered_map<FilterKey, std::list<Entry>::iterator, KeyHash> entries;     /**< Where each key is in recent */
+    qint64 bytesUsed;                                                               /**< Total size of the cached meshes */
+    qint64 memoryLimit;                                                             /**< Most the cached meshes may use */
+    qint64 hits;                                                                    /**< Number of successful lookups */
+    qint64 misses;                                                                  /**< Number of failed lookups */
+};
+
+#endif
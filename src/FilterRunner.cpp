@@ -0,0 +1,131 @@
+/**     @file FilterRunner.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ */
+
+#include "FilterRunner.h"
+#include "FilterCache.h"
+
+#include <QThread>
+
+FilterRunner::FilterRunner(QObject *parent)
+    : QObject(parent)
+{
+    /* Leave a core for the GUI and VR threads */
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+}
+
+FilterRunner::~FilterRunner()
+{
+    cancelAll();
+    pool.waitForDone();
+}
+
+bool FilterRunner::applyFilters(ModelPart *part)
+{
+    vtkSmartPointer<vtkActor> actor = part->getVRActor();
+    if (actor == nullptr || !part->isResident())
+        return false;
+
+    /* Only the latest state of a part's stack is wanted */
+    std::shared_ptr<std::atomic_bool> previous = jobs.value(actor);
+    if (previous)
+        *previous = true;
+    jobs.remove(actor);
+
+    std::vector<PartFilter> stack = part->filters();
+    if (stack.empty())
+    {
+        emit filterFinished(actor, part->getVRPolyData());
+        return true;
+    }
+
+    /* Stages that have been run before on the same mesh are taken from the cache, so after an
+     * edit only the edited stage and the ones after it run
+     */
+    FilterKey key = {part->geometryKey(), stack};
+    std::size_t first = 0;
+    vtkSmartPointer<vtkPolyData> input = FilterCache::instance().find(key, first);
+    if (first == stack.size())
+    {
+        emit filterFinished(actor, input);
+        return true;
+    }
+    if (input == nullptr)
+        input = part->getFilterInput();
+
+    std::shared_ptr<std::atomic_bool> cancelled = std::make_shared<std::atomic_bool>(false);
+    jobs.insert(actor, cancelled);
+
+    pool.start([this, actor, input, stack, key, first, cancelled]()
+               {
+        /* Runs on a worker thread - each stage's input is this job's own view, nothing else reads it */
+        vtkSmartPointer<vtkPolyData> stageInput = input;
+        FilterKey stageKey = key;
+        int reported = -1;
+
+        for (std::size_t stage = first; stage < stack.size() && stageInput != nullptr; stage++)
+        {
+            double done = double(stage - first) / double(stack.size() - first);
+            double share = 1. / double(stack.size() - first);
+
+            vtkSmartPointer<vtkPolyData> output = stack[stage].apply(stageInput, cancelled.get(), [this, cancelled, &reported, done, share](double progress)
+                {
+                    /* Only send whole percentages so the GUI isn't flooded */
+                    int percent = int((done + progress * share) * 100.);
+                    if (percent == reported)
+                        return;
+                    reported = percent;
+
+                    QMetaObject::invokeMethod(
+                        this, [this, cancelled, percent]()
+                        {
+                            if (!*cancelled)
+                                emit progressChanged(percent);
+                        },
+                        Qt::QueuedConnection);
+                });
+
+            if (output == nullptr)
+            {
+                stageInput = nullptr;
+                break;
+            }
+
+            /* The cache keeps the output itself, the next stage and the actor get a view of it like any later hit */
+            stageInput = vtkSmartPointer<vtkPolyData>::New();
+            stageInput->ShallowCopy(output);
+            stageKey.filters.assign(stack.begin(), stack.begin() + stage + 1);
+            FilterCache::instance().insert(stageKey, output);
+        }
+
+        /* Hand the result back to the runner's thread */
+        QMetaObject::invokeMethod(
+            this, [this, actor, stageInput, cancelled]()
+            {
+                if (*cancelled)
+                    return;
+
+                jobs.remove(actor);
+                if (stageInput != nullptr)
+                    emit filterFinished(actor, stageInput);
+            },
+            Qt::QueuedConnection); });
+
+    return true;
+}
+
+void FilterRunner::cancelAll()
+{
+    /* Drop jobs that haven't started and tell the running workers to give up */
+    pool.clear();
+    for (const std::shared_ptr<std::atomic_bool> &cancelled : jobs)
+        *cancelled = true;
+    jobs.clear();
+}
+
+bool FilterRunner::isBusy() const
+{
+    return !jobs.isEmpty();
+}
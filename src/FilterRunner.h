@@ -0,0 +1,94 @@
+/**     @file FilterRunner.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief This class runs part filters on a pool of worker threads
+ */
+
+#ifndef VIEWER_FILTERRUNNER_H
+#define VIEWER_FILTERRUNNER_H
+
+#include <QObject>
+#include <QHash>
+#include <QThreadPool>
+
+#include "ModelPart.h"
+#include "PartFilter.h"
+
+#include <atomic>
+#include <memory>
+
+/**
+ * @class FilterRunner
+ * @brief Filters the meshes of parts on worker threads and hands the results back to the GUI thread
+ *
+ * A job runs a part's filter stack, each stage on the output of the one before, starting from its own
+ * read-only view of the part's mesh, so neither the GUI nor the VR thread is held up while it runs.
+ * Results are delivered through filterFinished() on the thread that owns the runner (the GUI thread).
+ * A part has at most one job that counts: filtering it again cancels the job already running for it.
+ * The output of every stage is kept in the FilterCache, so stages that have been run before on the
+ * same mesh are skipped and a stack that is fully cached is delivered straight away.
+ */
+class FilterRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructor
+     * @param parent The parent object.
+     */
+    explicit FilterRunner(QObject *parent = nullptr);
+
+    /**
+     * @brief Destructor
+     * @brief Cancels the running jobs and waits for the workers to finish
+     */
+    ~FilterRunner();
+
+    /**
+     * @brief Start running a part's filter stack in the background
+     * @brief Call again whenever the stack changes, an empty stack delivers the unfiltered mesh
+     * @param part The part to filter, its geometry must be loaded
+     * @return false if the part has no geometry to filter
+     */
+    bool applyFilters(ModelPart *part);
+
+    /**
+     * @brief Cancel every running job, none of them will report a result
+     */
+    void cancelAll();
+
+    /**
+     * @brief Check if any job is running
+     * @return true if a job is running
+     */
+    bool isBusy() const;
+
+signals:
+    /**
+     * @brief Emitted on the runner's thread when a job has finished
+     * @param actor The VR actor of the part the job was started for
+     * @param output The filtered mesh, or the part's own mesh if its stack is empty
+     */
+    void filterFinished(vtkSmartPointer<vtkActor> actor, vtkSmartPointer<vtkPolyData> output);
+
+    /**
+     * @brief Emitted on the runner's thread as a job makes progress
+     * @param percent How much of the job is done
+     */
+    void progressChanged(int percent);
+
+private:
+    /**
+     * @brief The worker threads
+     */
+    QThreadPool pool;
+
+    /**
+     * @brief Cancel flag of the running job of each VR actor, shared with its worker
+     */
+    QHash<vtkActor *, std::shared_ptr<std::atomic_bool>> jobs;
+};
+
+#endif
@@ -0,0 +1,112 @@
+/**     @file GeometryCache.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ */
+
+#include "GeometryCache.h"
+
+GeometryCache::GeometryCache() : hits(0)
+{
+}
+
+GeometryCache &GeometryCache::instance()
+{
+    static GeometryCache cache;
+    return cache;
+}
+
+PartMesh GeometryCache::find(const GeometryKey &key)
+{
+    QMutexLocker locker(&mutex);
+
+    auto it = entries.find(key);
+    if (it == entries.end())
+        return PartMesh();
+
+    hits++;
+    return it->second.mesh;
+}
+
+PartMesh GeometryCache::insert(const PartMesh &mesh)
+{
+    if (!mesh.key.isValid() || mesh.polyData == nullptr)
+        return mesh;
+
+    QMutexLocker locker(&mutex);
+
+    /* If another reader finished the same file first, use its mesh and let this one go */
+    auto it = entries.find(mesh.key);
+    if (it != entries.end())
+        return it->second.mesh;
+
+    seal(mesh);
+    entries[mesh.key].mesh = mesh;
+    return mesh;
+}
+
+PartMesh GeometryCache::acquire(const PartMesh &mesh)
+{
+    if (!mesh.key.isValid() || mesh.polyData == nullptr)
+        return mesh;
+
+    QMutexLocker locker(&mutex);
+
+    Entry &entry = entries[mesh.key];
+    if (entry.mesh.polyData == nullptr)
+    {
+        seal(mesh);
+        entry.mesh = mesh;
+    }
+    entry.users++;
+
+    return entry.mesh;
+}
+
+void GeometryCache::release(const GeometryKey &key)
+{
+    if (!key.isValid())
+        return;
+
+    QMutexLocker locker(&mutex);
+
+    auto it = entries.find(key);
+    if (it == entries.end())
+        return;
+
+    /* Dropping the entry releases the cache's reference, so the mesh is freed
+     * once the renderers have finished with it too
+     */
+    if (--it->second.users <= 0)
+        entries.erase(it);
+}
+
+void GeometryCache::dropUnused(const GeometryKey &key)
+{
+    QMutexLocker locker(&mutex);
+
+    /* Only this key, a newer import may have added other meshes it hasn't claimed yet */
+    auto it = entries.find(key);
+    if (it != entries.end() && it->second.users <= 0)
+        entries.erase(it);
+}
+
+void GeometryCache::seal(const PartMesh &mesh)
+{
+    /* Computing the bounds caches them in the points, after this GetBounds() only reads,
+     * so any thread can ask for them once the mesh is shared
+     */
+    mesh.polyData->GetBounds();
+}
+
+int GeometryCache::meshCount()
+{
+    QMutexLocker locker(&mutex);
+    return int(entries.size());
+}
+
+qint64 GeometryCache::hitCount()
+{
+    QMutexLocker locker(&mutex);
+    return hits;
+}
@@ -0,0 +1,120 @@
+/**     @file GeometryCache.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief Process-wide cache that lets parts loaded from identical files share one mesh
+ */
+
+#ifndef VIEWER_GEOMETRYCACHE_H
+#define VIEWER_GEOMETRYCACHE_H
+
+#include "PartMesh.h"
+
+#include <QMutex>
+
+#include <unordered_map>
+
+/**
+ * @class GeometryCache
+ * @brief Shares one immutable mesh between all the parts loaded from files with the same content
+ *
+ * Meshes are keyed by a hash of the file's bytes (plus its size and the welding tolerance), so
+ * identical files saved under different names are only parsed once. Readers add meshes with insert()
+ * and parts claim them with acquire() when they are given their geometry. Each part releases its claim
+ * when it is deleted and the cache drops the mesh when the last claim goes, so the geometry is freed
+ * once no part uses it. All functions are thread safe.
+ *
+ * Shared meshes must be treated as read-only - filters should produce new data objects.
+ */
+class GeometryCache
+{
+public:
+    /**
+     * @brief Get the cache
+     * @return the process-wide instance
+     */
+    static GeometryCache &instance();
+
+    /**
+     * @brief Look up a mesh
+     * @param key The key of the file
+     * @return the cached mesh, with a null polydata if there isn't one
+     */
+    PartMesh find(const GeometryKey &key);
+
+    /**
+     * @brief Add a freshly read mesh, unclaimed until a part calls acquire()
+     * @param mesh The mesh to add, its key must be valid
+     * @return the cached mesh, which is a different one if another reader got there first
+     */
+    PartMesh insert(const PartMesh &mesh);
+
+    /**
+     * @brief Claim a mesh for a part
+     * @param mesh The mesh the part was given, added to the cache if it isn't already there
+     * @return the cached mesh the part should use
+     */
+    PartMesh acquire(const PartMesh &mesh);
+
+    /**
+     * @brief Give up a part's claim on a mesh, the mesh is dropped once it has no claims left
+     * @param key The key of the mesh
+     */
+    void release(const GeometryKey &key);
+
+    /**
+     * @brief Drop a mesh if no part has claimed it (e.g. a file read by a cancelled import)
+     * @param key The key of the mesh
+     */
+    void dropUnused(const GeometryKey &key);
+
+    /**
+     * @brief Get the number of meshes in the cache
+     * @return number of distinct meshes
+     */
+    int meshCount();
+
+    /**
+     * @brief Get the number of lookups that found a mesh
+     * @return number of files that didn't need parsing
+     */
+    qint64 hitCount();
+
+private:
+    /**
+     * @brief Constructor, use instance()
+     */
+    GeometryCache();
+
+    /**
+     * @brief Compute the cached state of a mesh before it is shared between threads
+     * @param mesh The mesh about to be added
+     */
+    static void seal(const PartMesh &mesh);
+
+    /**
+     * @brief Hash function for the key map
+     */
+    struct KeyHash
+    {
+        std::size_t operator()(const GeometryKey &key) const
+        {
+            return std::size_t(key.contentHash ^ quint64(key.fileSize) * 0x9e3779b97f4a7c15ULL);
+        }
+    };
+
+    /**
+     * @brief A cached mesh and the number of parts using it
+     */
+    struct Entry
+    {
+        PartMesh mesh;
+        int users = 0;
+    };
+
+    QMutex mutex;                                                  /**< Guards everything below */
+    std::unordered_map<GeometryKey, Entry, KeyHash> entries;       /**< The cached meshes */
+    qint64 hits;                                                   /**< Number of successful lookups */
+};
+
+#endif
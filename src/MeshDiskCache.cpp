@@ -0,0 +1,329 @@
+/**     @file MeshDiskCache.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ */
+
+#include "MeshDiskCache.h"
+#include "STLMeshReader.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkFloatArray.h>
+#include <vtkPoints.h>
+#include <vtkTypeInt32Array.h>
+#include <vtkTypeInt64Array.h>
+
+#include <cstring>
+#include <type_traits>
+
+namespace
+{
+    const char entryMagic[8] = {'V', 'R', 'B', 'S', 'M', 'E', 'S', 'H'};
+    const quint32 entryVersion = 1;
+    const qint64 defaultMaxBytes = qint64(2) << 30;
+
+    /* Fixed size header at the start of every entry. It is followed by the points (3 floats each),
+     * the triangle normals (3 floats each) and the connectivity (3 ids of indexSize bytes each).
+     * Everything is in the machine's own byte order - the cache is local to the machine anyway.
+     */
+    struct Header
+    {
+        char magic[8];
+        quint32 version;
+        quint32 indexSize;
+        qint64 sourceSize;
+        qint64 sourceModified;
+        double weldTolerance;
+        quint64 contentHash;
+        qint64 pointCount;
+        qint64 triangleCount;
+        qint64 vertexCountBeforeWeld;
+        double bounds[6];
+        quint64 checksum;
+    };
+    static_assert(std::is_trivially_copyable<Header>::value, "Header is written as raw bytes");
+
+    /* Sizes of the arrays that follow a header */
+    struct Layout
+    {
+        qint64 pointBytes;
+        qint64 normalBytes;
+        qint64 cellBytes;
+
+        explicit Layout(const Header &header)
+            : pointBytes(qint64(3 * sizeof(float)) * header.pointCount),
+              normalBytes(qint64(3 * sizeof(float)) * header.triangleCount),
+              cellBytes(qint64(3) * header.indexSize * header.triangleCount)
+        {
+        }
+
+        qint64 total() const
+        {
+            return qint64(sizeof(Header)) + pointBytes + normalBytes + cellBytes;
+        }
+    };
+
+    /* Combine the hashes of the three arrays into one checksum */
+    quint64 payloadChecksum(const uchar *points, const uchar *normals, const uchar *cells, const Layout &layout)
+    {
+        quint64 h = STLMeshReader::hashBytes(points, layout.pointBytes);
+        h = h * 0x9e3779b97f4a7c15ULL ^ STLMeshReader::hashBytes(normals, layout.normalBytes);
+        h = h * 0x9e3779b97f4a7c15ULL ^ STLMeshReader::hashBytes(cells, layout.cellBytes);
+        return h;
+    }
+
+    /* Check that a header is from this version and describes the current state of the source file */
+    bool isUpToDate(const Header &header, const QFileInfo &source, double weldTolerance)
+    {
+        return std::memcmp(header.magic, entryMagic, sizeof(entryMagic)) == 0 &&
+               header.version == entryVersion &&
+               (header.indexSize == 4 || header.indexSize == 8) &&
+               header.pointCount >= 0 && header.triangleCount > 0 &&
+               header.sourceSize == source.size() &&
+               header.sourceModified == source.lastModified().toMSecsSinceEpoch() &&
+               header.weldTolerance == weldTolerance;
+    }
+}
+
+MeshDiskCache::MeshDiskCache() : maxBytes(defaultMaxBytes)
+{
+    dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/meshes";
+}
+
+MeshDiskCache &MeshDiskCache::instance()
+{
+    static MeshDiskCache cache;
+    return cache;
+}
+
+void MeshDiskCache::setDirectory(const QString &path)
+{
+    QMutexLocker locker(&mutex);
+    dir = path;
+}
+
+QString MeshDiskCache::directory()
+{
+    QMutexLocker locker(&mutex);
+    return dir;
+}
+
+void MeshDiskCache::setMaxSize(qint64 bytes)
+{
+    QMutexLocker locker(&mutex);
+    maxBytes = bytes;
+}
+
+qint64 MeshDiskCache::maxSize()
+{
+    QMutexLocker locker(&mutex);
+    return maxBytes;
+}
+
+QString MeshDiskCache::entryPath(const QFileInfo &source, double weldTolerance)
+{
+    QString cacheDir = directory();
+    if (cacheDir.isEmpty())
+        return QString();
+
+    /* Name the entry after the file it caches - the size and modification time are checked
+     * against the header, so an out of date entry is simply overwritten
+     */
+    QByteArray name = source.absoluteFilePath().toUtf8() + '\n' + QByteArray::number(weldTolerance, 'g', 17);
+    return cacheDir + "/" + QCryptographicHash::hash(name, QCryptographicHash::Sha1).toHex() + ".mesh";
+}
+
+bool MeshDiskCache::readInfo(const QString &fileName, double weldTolerance, EntryInfo &info)
+{
+    QFileInfo source(fileName);
+    QString path = entryPath(source, weldTolerance);
+    if (path.isEmpty())
+        return false;
+
+    QFile entry(path);
+    if (!entry.open(QIODevice::ReadOnly))
+        return false;
+
+    Header header;
+    if (entry.read(reinterpret_cast<char *>(&header), sizeof(header)) != qint64(sizeof(header)))
+        return false;
+
+    if (!isUpToDate(header, source, weldTolerance) || entry.size() != Layout(header).total())
+        return false;
+
+    info.key.contentHash = header.contentHash;
+    info.key.fileSize = header.sourceSize;
+    info.key.weldTolerance = header.weldTolerance;
+    info.triangleCount = header.triangleCount;
+    std::memcpy(info.bounds, header.bounds, sizeof(info.bounds));
+    return true;
+}
+
+PartMesh MeshDiskCache::load(const QString &fileName, double weldTolerance)
+{
+    PartMesh mesh;
+
+    QFileInfo source(fileName);
+    QString path = entryPath(source, weldTolerance);
+    if (path.isEmpty())
+        return mesh;
+
+    QFile entry(path);
+    if (!entry.open(QIODevice::ReadOnly) || entry.size() < qint64(sizeof(Header)))
+        return mesh;
+
+    uchar *mapping = entry.map(0, entry.size());
+    if (!mapping)
+        return mesh;
+
+    /* 1. Make sure the entry is current and intact */
+    Header header;
+    std::memcpy(&header, mapping, sizeof(header));
+    Layout layout(header);
+
+    const uchar *points = mapping + sizeof(Header);
+    const uchar *normals = points + layout.pointBytes;
+    const uchar *cells = normals + layout.normalBytes;
+
+    if (!isUpToDate(header, source, weldTolerance) || entry.size() != layout.total() ||
+        payloadChecksum(points, normals, cells, layout) != header.checksum)
+    {
+        entry.unmap(mapping);
+        return mesh;
+    }
+
+    /* 2. Copy the arrays straight out of the mapping */
+    vtkSmartPointer<vtkFloatArray> coords = vtkSmartPointer<vtkFloatArray>::New();
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(header.pointCount);
+    std::memcpy(coords->GetPointer(0), points, layout.pointBytes);
+
+    vtkSmartPointer<vtkFloatArray> cellNormals = vtkSmartPointer<vtkFloatArray>::New();
+    cellNormals->SetName("Normals");
+    cellNormals->SetNumberOfComponents(3);
+    cellNormals->SetNumberOfTuples(header.triangleCount);
+    std::memcpy(cellNormals->GetPointer(0), normals, layout.normalBytes);
+
+    vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+    if (header.indexSize == 4)
+    {
+        vtkSmartPointer<vtkTypeInt32Array> connectivity = vtkSmartPointer<vtkTypeInt32Array>::New();
+        connectivity->SetNumberOfValues(3 * header.triangleCount);
+        std::memcpy(connectivity->GetPointer(0), cells, layout.cellBytes);
+        polys->SetData(3, connectivity);
+    }
+    else
+    {
+        vtkSmartPointer<vtkTypeInt64Array> connectivity = vtkSmartPointer<vtkTypeInt64Array>::New();
+        connectivity->SetNumberOfValues(3 * header.triangleCount);
+        std::memcpy(connectivity->GetPointer(0), cells, layout.cellBytes);
+        polys->SetData(3, connectivity);
+    }
+
+    entry.unmap(mapping);
+
+    /* Mark the entry as recently used */
+    entry.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+
+    vtkSmartPointer<vtkPoints> meshPoints = vtkSmartPointer<vtkPoints>::New();
+    meshPoints->SetData(coords);
+
+    mesh.polyData = vtkSmartPointer<vtkPolyData>::New();
+    mesh.polyData->SetPoints(meshPoints);
+    mesh.polyData->SetPolys(polys);
+    mesh.polyData->GetCellData()->SetNormals(cellNormals);
+
+    mesh.key.contentHash = header.contentHash;
+    mesh.key.fileSize = header.sourceSize;
+    mesh.key.weldTolerance = header.weldTolerance;
+    mesh.weldTolerance = header.weldTolerance;
+    mesh.vertexCountBeforeWeld = header.vertexCountBeforeWeld;
+    mesh.vertexCountAfterWeld = header.pointCount;
+    return mesh;
+}
+
+void MeshDiskCache::store(const QString &fileName, const PartMesh &mesh)
+{
+    if (mesh.polyData == nullptr || !mesh.key.isValid())
+        return;
+
+    /* Only float points, triangles and triangle normals are stored */
+    vtkPoints *meshPoints = mesh.polyData->GetPoints();
+    vtkFloatArray *coords = meshPoints ? vtkFloatArray::SafeDownCast(meshPoints->GetData()) : nullptr;
+    vtkCellArray *polys = mesh.polyData->GetPolys();
+    vtkFloatArray *cellNormals = vtkFloatArray::SafeDownCast(mesh.polyData->GetCellData()->GetNormals());
+    if (coords == nullptr || polys == nullptr || cellNormals == nullptr ||
+        polys->IsHomogeneous() != 3 || cellNormals->GetNumberOfTuples() != polys->GetNumberOfCells())
+        return;
+
+    QFileInfo source(fileName);
+    QString path = entryPath(source, mesh.weldTolerance);
+    if (path.isEmpty())
+        return;
+
+    /* 1. Fill in the header */
+    Header header;
+    std::memcpy(header.magic, entryMagic, sizeof(entryMagic));
+    header.version = entryVersion;
+    header.indexSize = polys->IsStorage64Bit() ? 8 : 4;
+    header.sourceSize = source.size();
+    header.sourceModified = source.lastModified().toMSecsSinceEpoch();
+    header.weldTolerance = mesh.weldTolerance;
+    header.contentHash = mesh.key.contentHash;
+    header.pointCount = coords->GetNumberOfTuples();
+    header.triangleCount = polys->GetNumberOfCells();
+    header.vertexCountBeforeWeld = mesh.vertexCountBeforeWeld;
+    mesh.polyData->GetBounds(header.bounds);
+
+    Layout layout(header);
+    const uchar *points = reinterpret_cast<const uchar *>(coords->GetPointer(0));
+    const uchar *normals = reinterpret_cast<const uchar *>(cellNormals->GetPointer(0));
+    const uchar *cells = polys->IsStorage64Bit()
+                             ? reinterpret_cast<const uchar *>(polys->GetConnectivityArray64()->GetPointer(0))
+                             : reinterpret_cast<const uchar *>(polys->GetConnectivityArray32()->GetPointer(0));
+    header.checksum = payloadChecksum(points, normals, cells, layout);
+
+    /* 2. Write to a temporary file that replaces the entry once it is complete, so a crash or a
+     * concurrent reader never sees half an entry
+     */
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile entry(path);
+    if (!entry.open(QIODevice::WriteOnly))
+        return;
+
+    entry.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    entry.write(reinterpret_cast<const char *>(points), layout.pointBytes);
+    entry.write(reinterpret_cast<const char *>(normals), layout.normalBytes);
+    entry.write(reinterpret_cast<const char *>(cells), layout.cellBytes);
+    if (!entry.commit())
+        return;
+
+    /* 3. Keep the cache under its cap */
+    evict(QFileInfo(path).absolutePath());
+}
+
+void MeshDiskCache::evict(const QString &cacheDir)
+{
+    QMutexLocker locker(&mutex);
+
+    /* Oldest first - entries are touched whenever they are loaded */
+    QFileInfoList entries = QDir(cacheDir).entryInfoList(QStringList() << "*.mesh", QDir::Files,
+                                                         QDir::Time | QDir::Reversed);
+    qint64 total = 0;
+    for (const QFileInfo &entry : entries)
+        total += entry.size();
+
+    for (int i = 0; i < entries.size() && total > maxBytes; i++)
+    {
+        if (QFile::remove(entries[i].absoluteFilePath()))
+            total -= entries[i].size();
+    }
+}
@@ -0,0 +1,122 @@
+/**     @file MeshDiskCache.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief On-disk cache of preprocessed meshes, so files don't need parsing again on the next launch
+ */
+
+#ifndef VIEWER_MESHDISKCACHE_H
+#define VIEWER_MESHDISKCACHE_H
+
+#include "PartMesh.h"
+
+#include <QFileInfo>
+#include <QMutex>
+#include <QString>
+
+/**
+ * @class MeshDiskCache
+ * @brief Stores the welded mesh of each STL file in a compact binary file in a cache directory
+ *
+ * Entries are keyed by the STL file's path, modification time and size (and the welding tolerance),
+ * so editing or replacing a file makes its entry stale. Each entry holds the welded points, the
+ * triangle normals and connectivity, the bounds, triangle count and content hash of the source file,
+ * and a checksum of the arrays. Loading maps the entry and copies the arrays straight out; an entry
+ * that doesn't match its source or fails the checksum is ignored so the caller re-parses the file.
+ *
+ * The total size of the directory is capped, the least recently used entries are deleted first.
+ * All functions are thread safe.
+ */
+class MeshDiskCache
+{
+public:
+    /**
+     * @brief What is known about an entry without loading its arrays
+     */
+    struct EntryInfo
+    {
+        GeometryKey key;          /**< Key of the mesh in the GeometryCache */
+        vtkIdType triangleCount;  /**< Number of triangles in the mesh */
+        double bounds[6];         /**< Bounds of the mesh */
+    };
+
+    /**
+     * @brief Get the cache
+     * @return the process-wide instance
+     */
+    static MeshDiskCache &instance();
+
+    /**
+     * @brief Set the directory entries are kept in
+     * @param path Directory to use, an empty path turns the cache off
+     */
+    void setDirectory(const QString &path);
+
+    /**
+     * @brief Get the directory entries are kept in
+     * @return directory path, empty if the cache is off
+     */
+    QString directory();
+
+    /**
+     * @brief Set the size cap of the cache directory
+     * @param bytes Maximum total size of all entries
+     */
+    void setMaxSize(qint64 bytes);
+
+    /**
+     * @brief Get the size cap of the cache directory
+     * @return maximum total size of all entries in bytes
+     */
+    qint64 maxSize();
+
+    /**
+     * @brief Read the header of the entry for a file
+     * @param fileName The STL file
+     * @param weldTolerance The welding tolerance the mesh is wanted for
+     * @param info Receives the entry's key, triangle count and bounds
+     * @return false if there is no up to date entry for the file
+     */
+    bool readInfo(const QString &fileName, double weldTolerance, EntryInfo &info);
+
+    /**
+     * @brief Load the mesh for a file
+     * @param fileName The STL file
+     * @param weldTolerance The welding tolerance the mesh is wanted for
+     * @return the mesh, with a null polydata if there is no entry or it is stale or corrupt
+     */
+    PartMesh load(const QString &fileName, double weldTolerance);
+
+    /**
+     * @brief Write the mesh for a file, then evict old entries if the cache is over its cap
+     * @param fileName The STL file the mesh was read from
+     * @param mesh The welded mesh, with cell normals
+     */
+    void store(const QString &fileName, const PartMesh &mesh);
+
+private:
+    /**
+     * @brief Constructor, use instance()
+     */
+    MeshDiskCache();
+
+    /**
+     * @brief Get the path of the entry for a file
+     * @param source The STL file
+     * @param weldTolerance The welding tolerance
+     * @return path of the entry, empty if the cache is off
+     */
+    QString entryPath(const QFileInfo &source, double weldTolerance);
+
+    /**
+     * @brief Delete the least recently used entries until the cache is under its cap
+     * @param dir The cache directory
+     */
+    void evict(const QString &dir);
+
+    QMutex mutex;    /**< Guards the settings and serialises writes */
+    QString dir;     /**< Cache directory, empty if the cache is off */
+    qint64 maxBytes; /**< Size cap of the directory */
+};
+
+#endif
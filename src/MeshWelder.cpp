@@ -0,0 +1,440 @@
+/**     @file MeshWelder.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ */
+
+#include "MeshWelder.h"
+
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkIdTypeArray.h>
+#include <vtkMath.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+#include <vtkTypeInt32Array.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    /* The top bits of each hash pick one of these partitions, each is welded by one thread */
+    const int partitionBits = 8;
+    const vtkIdType partitionCount = vtkIdType(1) << partitionBits;
+    const int partitionShift = 64 - partitionBits;
+
+    /* Number of vertices (or triangles) handed to a thread at a time */
+    const vtkIdType grain = 1 << 14;
+
+    /* Upper limit on the number of blocks used for the counting sort and prefix sums */
+    const vtkIdType maxBlocks = 1024;
+
+    /* 64 bit finaliser from MurmurHash3, spreads the quantised coordinates over all the bits */
+    inline std::uint64_t mix(std::uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    /* Maps vertices onto the welding grid. With no tolerance the grid coordinates are the bits of
+     * the floats themselves (with -0 turned into +0) so only identical vertices are merged.
+     * Everything here is straight line arithmetic so the hashing loop vectorises well.
+     */
+    struct Quantiser
+    {
+        double scale; /* 1 / tolerance, or 0 to merge identical vertices only */
+
+        inline void quantise(const float *p, std::int64_t q[3]) const
+        {
+            if (scale > 0.)
+            {
+                q[0] = std::llround(double(p[0]) * scale);
+                q[1] = std::llround(double(p[1]) * scale);
+                q[2] = std::llround(double(p[2]) * scale);
+            }
+            else
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    float f = p[k] + 0.0f;
+                    std::uint32_t bits;
+                    std::memcpy(&bits, &f, sizeof(bits));
+                    q[k] = bits;
+                }
+            }
+        }
+
+        inline std::uint64_t hash(const float *p) const
+        {
+            std::int64_t q[3];
+            quantise(p, q);
+            return mix(std::uint64_t(q[0]) * 0x9e3779b97f4a7c15ULL ^
+                       std::uint64_t(q[1]) * 0xc2b2ae3d27d4eb4fULL ^
+                       std::uint64_t(q[2]) * 0x165667b19e3779f9ULL);
+        }
+
+        inline bool equal(const float *a, const float *b) const
+        {
+            std::int64_t qa[3], qb[3];
+            quantise(a, qa);
+            quantise(b, qb);
+            return qa[0] == qb[0] && qa[1] == qb[1] && qa[2] == qb[2];
+        }
+    };
+
+    /* Split [0, n) into contiguous blocks for the passes that need per-block counts */
+    struct Blocks
+    {
+        vtkIdType count;
+        vtkIdType size;
+
+        explicit Blocks(vtkIdType n)
+        {
+            count = std::max<vtkIdType>(1, std::min<vtkIdType>((n + grain - 1) / grain, maxBlocks));
+            size = (n + count - 1) / count;
+        }
+    };
+
+    inline bool isCancelled(const std::atomic_bool *cancelled)
+    {
+        return cancelled && *cancelled;
+    }
+
+    /* Write the triangles that haven't collapsed into a connectivity array */
+    template <typename ArrayT>
+    vtkSmartPointer<vtkCellArray> buildTriangles(const std::vector<vtkIdType> &vertexMap, vtkIdType triangleCount)
+    {
+        typedef typename ArrayT::ValueType ValueT;
+
+        /* 1. Count the surviving triangles in each block */
+        Blocks blocks(triangleCount);
+        std::vector<vtkIdType> offsets(blocks.count + 1, 0);
+        auto countTriangles = [&](vtkIdType begin, vtkIdType end)
+        {
+            for (vtkIdType b = begin; b < end; b++)
+            {
+                vtkIdType kept = 0;
+                vtkIdType last = std::min(triangleCount, (b + 1) * blocks.size);
+                for (vtkIdType t = b * blocks.size; t < last; t++)
+                {
+                    const vtkIdType *v = &vertexMap[3 * t];
+                    kept += (v[0] != v[1] && v[1] != v[2] && v[2] != v[0]);
+                }
+                offsets[b + 1] = kept;
+            }
+        };
+        vtkSMPTools::For(0, blocks.count, 1, countTriangles);
+
+        for (vtkIdType b = 0; b < blocks.count; b++)
+            offsets[b + 1] += offsets[b];
+
+        /* 2. Each block writes its triangles from its offset onwards */
+        vtkSmartPointer<ArrayT> connectivity = vtkSmartPointer<ArrayT>::New();
+        connectivity->SetNumberOfValues(3 * offsets[blocks.count]);
+        ValueT *out = connectivity->GetPointer(0);
+
+        auto writeTriangles = [&](vtkIdType begin, vtkIdType end)
+        {
+            for (vtkIdType b = begin; b < end; b++)
+            {
+                ValueT *o = out + 3 * offsets[b];
+                vtkIdType last = std::min(triangleCount, (b + 1) * blocks.size);
+                for (vtkIdType t = b * blocks.size; t < last; t++)
+                {
+                    const vtkIdType *v = &vertexMap[3 * t];
+                    if (v[0] != v[1] && v[1] != v[2] && v[2] != v[0])
+                    {
+                        o[0] = ValueT(v[0]);
+                        o[1] = ValueT(v[1]);
+                        o[2] = ValueT(v[2]);
+                        o += 3;
+                    }
+                }
+            }
+        };
+        vtkSMPTools::For(0, blocks.count, 1, writeTriangles);
+
+        vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+        cells->SetData(3, connectivity);
+        return cells;
+    }
+}
+
+bool MeshWelder::weldVertices(const float *xyz, vtkIdType vertexCount, double tolerance,
+                              std::vector<vtkIdType> &vertexMap, std::vector<vtkIdType> &representatives,
+                              const std::atomic_bool *cancelled)
+{
+    const vtkIdType n = vertexCount;
+    vertexMap.assign(n, 0);
+    representatives.clear();
+    if (n == 0)
+        return true;
+
+    const Quantiser quant = {tolerance > 0. ? 1. / tolerance : 0.};
+
+    /* 1. Hash every vertex */
+    std::vector<std::uint64_t> keys(n);
+    auto hashVertices = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType i = begin; i < end; i++)
+            keys[i] = quant.hash(xyz + 3 * i);
+    };
+    vtkSMPTools::For(0, n, grain, hashVertices);
+
+    if (isCancelled(cancelled))
+        return false;
+
+    /* 2. Counting sort of the vertex indices by partition. Blocks are scattered in order, so within
+     * a partition the vertices stay in file order.
+     */
+    Blocks blocks(n);
+    std::vector<vtkIdType> counts(blocks.count * partitionCount, 0);
+    auto countBlocks = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType b = begin; b < end; b++)
+        {
+            vtkIdType *c = &counts[b * partitionCount];
+            vtkIdType last = std::min(n, (b + 1) * blocks.size);
+            for (vtkIdType i = b * blocks.size; i < last; i++)
+                c[keys[i] >> partitionShift]++;
+        }
+    };
+    vtkSMPTools::For(0, blocks.count, 1, countBlocks);
+
+    /* Turn the counts into the position each block starts writing each partition at */
+    std::vector<vtkIdType> partitionStart(partitionCount + 1);
+    vtkIdType total = 0;
+    for (vtkIdType p = 0; p < partitionCount; p++)
+    {
+        partitionStart[p] = total;
+        for (vtkIdType b = 0; b < blocks.count; b++)
+        {
+            vtkIdType c = counts[b * partitionCount + p];
+            counts[b * partitionCount + p] = total;
+            total += c;
+        }
+    }
+    partitionStart[partitionCount] = total;
+
+    std::vector<vtkIdType> order(n);
+    auto scatterBlocks = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType b = begin; b < end; b++)
+        {
+            vtkIdType *c = &counts[b * partitionCount];
+            vtkIdType last = std::min(n, (b + 1) * blocks.size);
+            for (vtkIdType i = b * blocks.size; i < last; i++)
+                order[c[keys[i] >> partitionShift]++] = i;
+        }
+    };
+    vtkSMPTools::For(0, blocks.count, 1, scatterBlocks);
+
+    if (isCancelled(cancelled))
+        return false;
+
+    /* 3. Weld each partition with an open addressing table. The first vertex seen with a key
+     * becomes the representative of all the later ones, vertexMap holds the representatives for now.
+     */
+    auto weldPartitions = [&](vtkIdType begin, vtkIdType end)
+    {
+        std::vector<vtkIdType> table;
+        for (vtkIdType p = begin; p < end; p++)
+        {
+            vtkIdType first = partitionStart[p];
+            vtkIdType last = partitionStart[p + 1];
+            if (first == last)
+                continue;
+
+            std::size_t size = 16;
+            while (size < std::size_t(2 * (last - first)))
+                size <<= 1;
+            std::size_t mask = size - 1;
+            table.assign(size, -1);
+
+            for (vtkIdType j = first; j < last; j++)
+            {
+                vtkIdType i = order[j];
+                std::uint64_t h = keys[i];
+                std::size_t slot = std::size_t(h) & mask;
+                while (true)
+                {
+                    vtkIdType r = table[slot];
+                    if (r < 0)
+                    {
+                        table[slot] = i;
+                        vertexMap[i] = i;
+                        break;
+                    }
+                    if (keys[r] == h && quant.equal(xyz + 3 * r, xyz + 3 * i))
+                    {
+                        vertexMap[i] = r;
+                        break;
+                    }
+                    slot = (slot + 1) & mask;
+                }
+            }
+        }
+    };
+    vtkSMPTools::For(0, partitionCount, 1, weldPartitions);
+
+    if (isCancelled(cancelled))
+        return false;
+
+    /* 4. Number the representatives in file order, reusing the order array for the new ids */
+    std::vector<vtkIdType> blockStart(blocks.count + 1, 0);
+    auto countRepresentatives = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType b = begin; b < end; b++)
+        {
+            vtkIdType count = 0;
+            vtkIdType last = std::min(n, (b + 1) * blocks.size);
+            for (vtkIdType i = b * blocks.size; i < last; i++)
+                count += (vertexMap[i] == i);
+            blockStart[b + 1] = count;
+        }
+    };
+    vtkSMPTools::For(0, blocks.count, 1, countRepresentatives);
+
+    for (vtkIdType b = 0; b < blocks.count; b++)
+        blockStart[b + 1] += blockStart[b];
+
+    representatives.resize(blockStart[blocks.count]);
+    std::vector<vtkIdType> &newId = order;
+    auto numberRepresentatives = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType b = begin; b < end; b++)
+        {
+            vtkIdType id = blockStart[b];
+            vtkIdType last = std::min(n, (b + 1) * blocks.size);
+            for (vtkIdType i = b * blocks.size; i < last; i++)
+            {
+                if (vertexMap[i] == i)
+                {
+                    newId[i] = id;
+                    representatives[id] = i;
+                    id++;
+                }
+            }
+        }
+    };
+    vtkSMPTools::For(0, blocks.count, 1, numberRepresentatives);
+
+    /* 5. Point every vertex at the new id of its representative */
+    auto remapVertices = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType i = begin; i < end; i++)
+            vertexMap[i] = newId[vertexMap[i]];
+    };
+    vtkSMPTools::For(0, n, grain, remapVertices);
+
+    return !isCancelled(cancelled);
+}
+
+vtkSmartPointer<vtkPolyData> MeshWelder::weld(vtkFloatArray *soup, double tolerance, const std::atomic_bool *cancelled)
+{
+    if (soup == nullptr || soup->GetNumberOfComponents() != 3)
+        return nullptr;
+
+    const vtkIdType n = soup->GetNumberOfTuples();
+    const float *xyz = soup->GetPointer(0);
+
+    std::vector<vtkIdType> vertexMap;
+    std::vector<vtkIdType> representatives;
+    if (!weldVertices(xyz, n, tolerance, vertexMap, representatives, cancelled))
+        return nullptr;
+
+    /* 1. Take each welded vertex from its representative in the soup */
+    const vtkIdType uniqueCount = vtkIdType(representatives.size());
+    vtkSmartPointer<vtkFloatArray> coords = vtkSmartPointer<vtkFloatArray>::New();
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(uniqueCount);
+    float *out = coords->GetPointer(0);
+
+    auto copyVertices = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType v = begin; v < end; v++)
+        {
+            const float *p = xyz + 3 * representatives[v];
+            out[3 * v] = p[0];
+            out[3 * v + 1] = p[1];
+            out[3 * v + 2] = p[2];
+        }
+    };
+    vtkSMPTools::For(0, uniqueCount, grain, copyVertices);
+
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetData(coords);
+
+    /* 2. Build the triangles, with 32 bit ids where they fit */
+    vtkSmartPointer<vtkCellArray> cells;
+    if (uniqueCount <= std::numeric_limits<vtkTypeInt32>::max())
+        cells = buildTriangles<vtkTypeInt32Array>(vertexMap, n / 3);
+    else
+        cells = buildTriangles<vtkIdTypeArray>(vertexMap, n / 3);
+
+    vtkSmartPointer<vtkPolyData> data = vtkSmartPointer<vtkPolyData>::New();
+    data->SetPoints(points);
+    data->SetPolys(cells);
+
+    return data;
+}
+
+void MeshWelder::computeCellNormals(vtkPolyData *mesh)
+{
+    if (mesh == nullptr || mesh->GetPoints() == nullptr || mesh->GetPolys() == nullptr)
+        return;
+
+    /* Only meshes made purely of triangles are handled */
+    vtkCellArray *polys = mesh->GetPolys();
+    if (polys->IsHomogeneous() != 3)
+        return;
+
+    const vtkIdType triangleCount = polys->GetNumberOfCells();
+    vtkPoints *points = mesh->GetPoints();
+
+    vtkSmartPointer<vtkFloatArray> normals = vtkSmartPointer<vtkFloatArray>::New();
+    normals->SetName("Normals");
+    normals->SetNumberOfComponents(3);
+    normals->SetNumberOfTuples(triangleCount);
+    float *out = normals->GetPointer(0);
+
+    auto computeAll = [&](const auto *connectivity)
+    {
+        auto computeNormals = [&](vtkIdType begin, vtkIdType end)
+        {
+            double a[3], b[3], c[3], ab[3], ac[3], n[3];
+            for (vtkIdType t = begin; t < end; t++)
+            {
+                points->GetPoint(vtkIdType(connectivity[3 * t]), a);
+                points->GetPoint(vtkIdType(connectivity[3 * t + 1]), b);
+                points->GetPoint(vtkIdType(connectivity[3 * t + 2]), c);
+                for (int k = 0; k < 3; k++)
+                {
+                    ab[k] = b[k] - a[k];
+                    ac[k] = c[k] - a[k];
+                }
+                vtkMath::Cross(ab, ac, n);
+                vtkMath::Normalize(n);
+                out[3 * t] = float(n[0]);
+                out[3 * t + 1] = float(n[1]);
+                out[3 * t + 2] = float(n[2]);
+            }
+        };
+        vtkSMPTools::For(0, triangleCount, grain, computeNormals);
+    };
+
+    if (polys->IsStorage64Bit())
+        computeAll(polys->GetConnectivityArray64()->GetPointer(0));
+    else
+        computeAll(polys->GetConnectivityArray32()->GetPointer(0));
+
+    mesh->GetCellData()->SetNormals(normals);
+}
@@ -0,0 +1,65 @@
+/**     @file MeshWelder.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief This class merges the duplicated vertices of an STL triangle soup
+ */
+
+#ifndef VIEWER_MESHWELDER_H
+#define VIEWER_MESHWELDER_H
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+#include <vtkFloatArray.h>
+
+#include <atomic>
+#include <vector>
+
+/**
+ * @class MeshWelder
+ * @brief Turns a triangle soup into an indexed mesh by merging duplicate vertices in parallel
+ *
+ * Each vertex is quantised to a grid with the welding tolerance as its spacing (or taken bit for bit
+ * when the tolerance is 0) and hashed. The vertices are bucketed on the top bits of the hash so each
+ * bucket can be deduplicated with its own hash table on a separate thread. Duplicates are mapped to
+ * the first vertex in the file with the same key, so the result doesn't depend on the number of
+ * threads and keeps the file's vertex order. Triangles that collapse after welding are dropped.
+ *
+ * The loops are run with vtkSMPTools, so they use whichever SMP backend VTK was built with.
+ */
+class MeshWelder
+{
+public:
+    /**
+     * @brief Find the welded vertex of every vertex in a soup
+     * @param xyz Vertex coordinates, 3 floats per vertex
+     * @param vertexCount Number of vertices
+     * @param tolerance Grid spacing for merging, 0 merges only identical vertices
+     * @param vertexMap Receives the index of the welded vertex for each input vertex
+     * @param representatives Receives the input vertex that each welded vertex was taken from
+     * @param cancelled is checked between passes, welding stops once it is set (may be null)
+     * @return false if welding was cancelled
+     */
+    static bool weldVertices(const float *xyz, vtkIdType vertexCount, double tolerance,
+                             std::vector<vtkIdType> &vertexMap, std::vector<vtkIdType> &representatives,
+                             const std::atomic_bool *cancelled = nullptr);
+
+    /**
+     * @brief Weld a triangle soup, where vertices 3i, 3i + 1 and 3i + 2 make up triangle i
+     * @param soup Vertex coordinates of the soup
+     * @param tolerance Grid spacing for merging, 0 merges only identical vertices
+     * @param cancelled is checked between passes, welding stops once it is set (may be null)
+     * @return the indexed mesh, or nullptr if welding was cancelled
+     */
+    static vtkSmartPointer<vtkPolyData> weld(vtkFloatArray *soup, double tolerance,
+                                             const std::atomic_bool *cancelled = nullptr);
+
+    /**
+     * @brief Give every triangle of a mesh a unit normal, computed in parallel
+     * The normals are stored as cell data so welded meshes still render with flat facets
+     * @param mesh Triangle mesh, any existing cell normals are replaced
+     */
+    static void computeCellNormals(vtkPolyData *mesh);
+};
+
+#endif
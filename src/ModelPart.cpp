@@ -5,16 +5,63 @@
  */
 
 #include "ModelPart.h"
+#include "STLMeshReader.h"
+#include "MeshWelder.h"
+#include "MeshDiskCache.h"
+#include "GeometryCache.h"
 #include "vtkProperty.h"
+#include <vtkOutlineSource.h>
 
-ModelPart::ModelPart(const QList<QVariant> &data, ModelPart *parent)
-    : m_itemData(data), m_parentItem(parent), folderFlag(false), VRActor(nullptr)
+#include <algorithm>
+
+namespace
+{
+    /* A polydata of its own that shares the arrays of a mesh. Each renderer draws one of these, so
+     * the two render threads never touch the same pipeline information or cached bounds, yet the
+     * points, normals and connectivity exist only once.
+     */
+    vtkSmartPointer<vtkPolyData> shareGeometry(vtkPolyData *mesh)
+    {
+        vtkSmartPointer<vtkPolyData> view = vtkSmartPointer<vtkPolyData>::New();
+        view->ShallowCopy(mesh);
+        return view;
+    }
+}
+
+ModelPart::ModelPart(ModelPartStore *store, const QList<QVariant> &data)
+    : m_store(store), m_weldTolerance(0.), m_vertexCountBeforeWeld(0), m_vertexCountAfterWeld(0),
+      m_triangleCount(0), m_resident(false), m_loading(false), VRActor(nullptr)
 {
+    /* Unpack the column data into the store once, so the getters never touch a QVariant.
+     * Items created with just a name (folders) only have the one column.
+     */
+    quint8 flags = 0;
+    if (data.size() < 2)
+        flags |= ModelPartStore::NameOnly;
+    else if (data.at(1).toBool())
+        flags |= ModelPartStore::Visible;
+
+    QRgb rgba = qRgb(255, 255, 255);
+    if (data.size() > 2)
+        rgba = data.at(2).value<QColor>().rgba();
+
+    m_node = m_store->create(data.value(0).toString(), flags, rgba, this);
 }
 
 ModelPart::~ModelPart()
 {
-    qDeleteAll(m_childItems);
+    /* Delete the children first, each one detaches itself and frees its own node.
+     * Going from the last child means no sibling has to move up a row, so a folder of N parts closes in O(N)
+     */
+    ModelPartStore::NodeId childNode;
+    while ((childNode = m_store->lastChild(m_node)) != ModelPartStore::NoNode)
+        delete m_store->part(childNode);
+
+    m_store->detach(m_node);
+    m_store->destroy(m_node);
+
+    /* Let the cache free the geometry if this was the last part using it */
+    GeometryCache::instance().release(m_geometryKey);
 }
 
 void ModelPart::appendChild(ModelPart *item)
@@ -22,31 +69,39 @@ void ModelPart::appendChild(ModelPart *item)
     /* Add another model part as a child of this part
      * (it will appear as a sub-branch in the treeview)
      */
-    item->m_parentItem = this;
-    m_childItems.append(item);
+    m_store->detach(item->m_node);
+    m_store->appendChild(m_node, item->m_node);
 }
 
 ModelPart *ModelPart::child(int row)
 {
     /* Return pointer to child item in row below this item.
      */
-    if (row < 0 || row >= m_childItems.size())
-        return nullptr;
-    return m_childItems.at(row);
+    return m_store->part(m_store->child(m_node, row));
 }
 
 int ModelPart::childCount() const
 {
     /* Count number of child items
      */
-    return m_childItems.count();
+    return m_store->childCount(m_node);
 }
 
 int ModelPart::columnCount() const
 {
     /* Count number of columns (properties) that this item has.
      */
-    return m_itemData.count();
+    return m_store->testFlag(m_node, ModelPartStore::NameOnly) ? 1 : 3;
+}
+
+ModelPartStore *ModelPart::store() const
+{
+    return m_store;
+}
+
+ModelPartStore::NodeId ModelPart::node() const
+{
+    return m_node;
 }
 
 QVariant ModelPart::data(int column) const
@@ -55,106 +110,299 @@ QVariant ModelPart::data(int column) const
      *  Note on the QVariant type - it is a generic placeholder type
      *  that can take on the type of most Qt classes. It allows each
      *  column or property to store data of an arbitrary type.
+     *  Only the tree view asks for QVariants, the values are stored unwrapped.
      */
-    if (column < 0 || column >= m_itemData.size())
+    if (column < 0 || column >= columnCount())
         return QVariant();
-    return m_itemData.at(column);
+
+    switch (column)
+    {
+    case 0:
+        return name();
+    case 1:
+        return visible();
+    default:
+        return colour();
+    }
 }
 
 void ModelPart::set(int column, const QVariant &value)
 {
     /* Set the data associated with a column of this item
      */
-    if (column < 0 || column >= m_itemData.size())
+    if (column < 0 || column >= columnCount())
         return;
 
-    m_itemData.replace(column, value);
+    switch (column)
+    {
+    case 0:
+        setName(value.toString());
+        break;
+    case 1:
+        setVisible(value.toBool());
+        break;
+    default:
+        setColour(value.value<QColor>());
+        break;
+    }
 }
 
 ModelPart *ModelPart::parentItem()
 {
-    return m_parentItem;
+    return m_store->part(m_store->parent(m_node));
 }
 
 int ModelPart::row() const
 {
     /* Return the row index of this item, relative to it's parent.
      */
-    if (m_parentItem)
-        return m_parentItem->m_childItems.indexOf(const_cast<ModelPart *>(this));
-    return 0;
+    return m_store->row(m_node);
 }
 
 void ModelPart::setColour(const QColor &colour)
 {
-    m_itemData[2] = colour;
+    m_store->setColour(m_node, colour.rgba());
 }
 
 QColor ModelPart::colour() const
 {
-    return m_itemData.at(2).value<QColor>();
+    return QColor::fromRgba(m_store->colour(m_node));
 }
 
 void ModelPart::setVisible(bool visibility)
 {
-    m_itemData[1] = visibility;
+    m_store->setFlag(m_node, ModelPartStore::Visible, visibility);
 }
 
 bool ModelPart::visible() const
 {
-    return m_itemData.at(1).value<bool>();
+    return m_store->testFlag(m_node, ModelPartStore::Visible);
 }
 
 void ModelPart::setName(const QString &name)
 {
-    m_itemData[0] = name;
+    m_store->setName(m_node, name);
 }
 
 QString ModelPart::name() const
 {
-    return m_itemData.at(0).value<QString>();
+    return m_store->name(m_node);
 }
 
 void ModelPart::setFolder()
 {
-    folderFlag = true;
+    m_store->setFlag(m_node, ModelPartStore::Folder, true);
 }
 
 bool ModelPart::isFolder() const
 {
-    return folderFlag;
+    return m_store->testFlag(m_node, ModelPartStore::Folder);
 }
 
 void ModelPart::removeChild(ModelPart *child)
 {
-    int index = m_childItems.indexOf(child);
-    if (index != -1)
+    if (child && m_store->parent(child->m_node) == m_node)
+        m_store->detach(child->m_node);
+}
+
+void ModelPart::loadSTL(QString fileName)
+{
+    m_filePath = fileName;
+    setMesh(readSTL(fileName, m_weldTolerance));
+}
+
+PartMesh ModelPart::readSTL(const QString &fileName, double weldTolerance, const std::atomic_bool *cancelled)
+{
+    PartMesh mesh;
+    mesh.weldTolerance = weldTolerance;
+
+    if (cancelled && *cancelled)
+        return mesh;
+
+    /* If the file was preprocessed before, its header tells us which mesh it is without reading
+     * the file at all, and the arrays can be copied straight out of the cache entry
+     */
+    MeshDiskCache::EntryInfo info;
+    if (MeshDiskCache::instance().readInfo(fileName, weldTolerance, info))
+    {
+        PartMesh cached = GeometryCache::instance().find(info.key);
+        if (cached.polyData != nullptr)
+            return cached;
+
+        PartMesh stored = MeshDiskCache::instance().load(fileName, weldTolerance);
+        if (cancelled && *cancelled)
+            return mesh;
+        if (stored.polyData != nullptr)
+            return GeometryCache::instance().insert(stored);
+
+        /* A corrupt entry is simply replaced once the file has been parsed again */
+    }
+
+    /* Binary files are read straight from a memory mapping */
+    STLMeshReader stl(fileName);
+    if (!stl.open())
+    {
+        qDebug() << "ERROR: unable to open" << fileName << stl.errorString();
+        return mesh;
+    }
+
+    /* Files with the same content share one mesh, so only parse the file if it hasn't been seen */
+    mesh.key.contentHash = stl.contentHash();
+    mesh.key.fileSize = stl.fileSize();
+    mesh.key.weldTolerance = weldTolerance;
+
+    PartMesh cached = GeometryCache::instance().find(mesh.key);
+    if (cached.polyData != nullptr)
+        return cached;
+
+    if (cancelled && *cancelled)
+        return mesh;
+
+    /* Read the triangle soup (binary and ASCII files alike), then merge the duplicated vertices in parallel */
+    vtkSmartPointer<vtkFloatArray> soup = stl.readVertices(cancelled);
+    if (soup != nullptr)
+    {
+        if (soup->GetNumberOfTuples() == 0)
+            return mesh;
+
+        mesh.polyData = MeshWelder::weld(soup, weldTolerance, cancelled);
+        mesh.vertexCountBeforeWeld = soup->GetNumberOfTuples();
+    }
+    else if (!stl.isBinary() && !(cancelled && *cancelled))
+    {
+        /* Fall back to VTK's reader for ASCII files our parser doesn't understand,
+         * using a reader local to this call so several files can be read in parallel
+         */
+        qDebug() << "WARNING:" << fileName << stl.errorString() << "- retrying with vtkSTLReader";
+
+        vtkSmartPointer<vtkSTLReader> reader = vtkSmartPointer<vtkSTLReader>::New();
+        reader->SetFileName(fileName.toStdString().c_str());
+        reader->Update();
+
+        /* The reader can't be interrupted, so throw the result away if we were cancelled meanwhile */
+        if (cancelled && *cancelled)
+            return mesh;
+
+        mesh.polyData = reader->GetOutput();
+        if (mesh.polyData != nullptr)
+            mesh.vertexCountBeforeWeld = 3 * mesh.polyData->GetNumberOfCells();
+    }
+
+    if (mesh.polyData == nullptr || mesh.polyData->GetNumberOfPoints() == 0)
     {
-        m_childItems.removeAt(index);
+        mesh.polyData = nullptr;
+        return mesh;
     }
+
+    mesh.vertexCountAfterWeld = mesh.polyData->GetNumberOfPoints();
+    MeshWelder::computeCellNormals(mesh.polyData);
+
+    /* If another thread read an identical file meanwhile, this returns its mesh instead */
+    mesh = GeometryCache::instance().insert(mesh);
+
+    /* Save the preprocessed mesh so the file doesn't need parsing next time */
+    if (!(cancelled && *cancelled))
+        MeshDiskCache::instance().store(fileName, mesh);
+
+    return mesh;
 }
 
-void ModelPart::loadSTL(QString fileName)
+bool ModelPart::readSTLHeader(const QString &fileName, double weldTolerance, PartHeader &header)
 {
-    // 1. Use the vtkSTLReader class to load the STL file
-    file = vtkSmartPointer<vtkSTLReader>::New();
-    file->SetFileName(fileName.toStdString().c_str());
-    file->Update();
+    header = PartHeader();
+
+    /* A file that has been loaded before has everything we need in its cache entry */
+    MeshDiskCache::EntryInfo info;
+    if (MeshDiskCache::instance().readInfo(fileName, weldTolerance, info))
+    {
+        header.triangleCount = info.triangleCount;
+        std::copy(info.bounds, info.bounds + 6, header.bounds);
+        header.hasBounds = true;
+        return true;
+    }
 
-    // 2. Initialise the part's vtkMapper and link it to the STL reader
+    STLMeshReader stl(fileName);
+    if (!stl.open())
+    {
+        qDebug() << "ERROR: unable to open" << fileName << stl.errorString();
+        return false;
+    }
+
+    /* Binary files have the count in their header and the bounds come from a sweep over the mapping,
+     * ASCII files would need parsing so they stay unknown until they are loaded
+     */
+    header.triangleCount = stl.triangleCount();
+    header.hasBounds = stl.computeBounds(header.bounds);
+    return true;
+}
+
+void ModelPart::setPlaceholder(const QString &fileName, const PartHeader &header)
+{
+    m_filePath = fileName;
+    m_triangleCount = header.triangleCount;
+    m_resident = false;
+
+    mapper = nullptr;
+    actor = nullptr;
+    VRMapper = nullptr;
+    VRActor = nullptr;
+
+    if (!header.hasBounds)
+        return;
+
+    /* Show a wireframe box where the part will be, it is only drawn on the desktop */
+    vtkSmartPointer<vtkOutlineSource> outline = vtkSmartPointer<vtkOutlineSource>::New();
+    outline->SetBounds(header.bounds[0], header.bounds[1], header.bounds[2],
+                       header.bounds[3], header.bounds[4], header.bounds[5]);
+
+    mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+    mapper->SetInputConnection(outline->GetOutputPort());
+
+    actor = vtkSmartPointer<vtkActor>::New();
+    actor->SetMapper(mapper);
+}
+
+void ModelPart::setMesh(const PartMesh &newMesh)
+{
+    if (newMesh.polyData == nullptr)
+    {
+        qDebug() << "ERROR: no geometry loaded for" << name();
+        return;
+    }
+
+    // 1. Claim the shared copy of the geometry and let go of any previous one
+    PartMesh mesh = GeometryCache::instance().acquire(newMesh);
+    GeometryCache::instance().release(m_geometryKey);
+    m_geometryKey = mesh.key;
+
+    polyData = mesh.polyData;
+    m_weldTolerance = mesh.weldTolerance;
+    m_vertexCountBeforeWeld = mesh.vertexCountBeforeWeld;
+    m_vertexCountAfterWeld = mesh.vertexCountAfterWeld;
+    m_triangleCount = polyData->GetNumberOfCells();
+    m_resident = true;
+    m_loading = false;
+
+    /* The mesh is read-only from here on, it may be shared with other parts and is drawn by both the
+     * GUI and VR threads. Its bounds were computed before it was shared, so this only reads them.
+     */
+    polyData->GetBounds();
+
+    // 2. Initialise the part's vtkMapper and link it to the geometry
     mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
-    mapper->SetInputConnection(file->GetOutputPort());
+    mapper->SetInputData(shareGeometry(polyData));
 
     // 3. Initialise the part's vtkActor and link to the mapper
     actor = vtkSmartPointer<vtkActor>::New();
     actor->SetMapper(mapper);
 
-	// 2a. Intialise the part's vtkMapper for VR and link it to the STL reader
+	// 2a. Intialise the part's vtkMapper for VR and link it to the geometry
+	VRPolyData = shareGeometry(polyData);
 	VRMapper = vtkSmartPointer<vtkDataSetMapper>::New();
-	VRMapper->SetInputConnection(file->GetOutputPort());
+	VRMapper->SetInputData(VRPolyData);
 
 	// 3a. Initialise the part's vtkActor for VR and link to the mapper
-	VRActor = vtkActor::New();
+	VRActor = vtkSmartPointer<vtkActor>::New();
 	VRActor->SetMapper(VRMapper);
 }
 
@@ -172,37 +420,95 @@ vtkSmartPointer<vtkActor> ModelPart::getVRActor() const
     return VRActor;
 }
 
-vtkActor *ModelPart::getNewActor()
+vtkSmartPointer<vtkPolyData> ModelPart::getVRPolyData() const
 {
+    return VRPolyData;
+}
 
-    vtkSmartPointer<vtkPolyData> pd = vtkSmartPointer<vtkPolyData>::New();
+vtkSmartPointer<vtkPolyData> ModelPart::getFilterInput() const
+{
+    if (polyData == nullptr)
+        return nullptr;
 
-    pd->DeepCopy(mapper->GetInputDataObject(0, 0));
+    return shareGeometry(polyData);
+}
 
-    VRMapper = vtkSmartPointer<vtkDataSetMapper>::New();
+const std::vector<PartFilter> &ModelPart::filters() const
+{
+    return m_filters;
+}
 
-    if (file == nullptr)
-    {
-        qDebug() << "ERROR: nothing in file reader";
-        return nullptr;
-    }
+void ModelPart::pushFilter(const PartFilter &filter)
+{
+    m_filters.push_back(filter);
+}
 
-    VRMapper->SetInputDataObject(pd);
+void ModelPart::setFilter(int stage, const PartFilter &filter)
+{
+    if (stage >= 0 && stage < int(m_filters.size()))
+        m_filters[stage] = filter;
+}
 
-    VRActor = vtkActor::New();
-    VRActor->SetMapper(VRMapper);
+bool ModelPart::popFilter()
+{
+    if (m_filters.empty())
+        return false;
 
-    VRActor->SetProperty(actor->GetProperty());
-    /* The new vtkActor pointer must be returned here */
-    return VRActor;
+    m_filters.pop_back();
+    return true;
+}
+
+void ModelPart::clearFilters()
+{
+    m_filters.clear();
+}
+
+void ModelPart::setWeldTolerance(double tolerance)
+{
+    m_weldTolerance = tolerance;
+}
+
+double ModelPart::weldTolerance() const
+{
+    return m_weldTolerance;
+}
+
+GeometryKey ModelPart::geometryKey() const
+{
+    return m_geometryKey;
+}
+
+vtkIdType ModelPart::vertexCountBeforeWeld() const
+{
+    return m_vertexCountBeforeWeld;
+}
+
+vtkIdType ModelPart::vertexCountAfterWeld() const
+{
+    return m_vertexCountAfterWeld;
+}
+
+bool ModelPart::isResident() const
+{
+    return m_resident;
+}
+
+void ModelPart::setLoading(bool loading)
+{
+    m_loading = loading;
+}
+
+bool ModelPart::isLoading() const
+{
+    return m_loading;
 }
 
-void ModelPart::setOriginalData(vtkSmartPointer<vtkDataSet> data)
+QString ModelPart::filePath() const
 {
-    originalData = data;
+    return m_filePath;
 }
 
-vtkSmartPointer<vtkDataSet> ModelPart::getOriginalData()
+vtkIdType ModelPart::triangleCount() const
 {
-    return originalData;
+    return m_triangleCount;
 }
@@ -24,22 +24,32 @@
 #include <vtkColor.h>
 #include <vtkPolyDataMapper.h>
 #include <vtkDataSetMapper.h>
+#include <vtkPolyData.h>
+#include "PartMesh.h"
+#include "ModelPartStore.h"
+#include "PartFilter.h"
+
+#include <atomic>
+#include <vector>
 
 /** ModelPart class
  * @class ModelPart
  * @brief This class represents a part in the model treeview
+ *
+ * The tree structure and the name, visibility and colour of each part live in a ModelPartStore,
+ * the ModelPart object holds the part's node id and its rendering state (mesh, mappers and actors).
  */
 class ModelPart
 {
 public:
   /** Constructor
+   * @param store is the node table the item's properties and tree links are kept in
    * @param data is a List (array) of strings for each property of this item (part name, visiblity and colour in our case)
-   * @param parent is the parent of this item (one level up in tree)
    */
-  ModelPart(const QList<QVariant> &data, ModelPart *parent = nullptr);
+  ModelPart(ModelPartStore *store, const QList<QVariant> &data);
 
   /** Destructor
-   * @brief Needs to free array of child items
+   * @brief Needs to free array of child items and release the part's shared geometry
    */
   ~ModelPart();
 
@@ -63,11 +73,21 @@ public:
                            * valid, but 'get' type functions are.
                            */
 
-  /** Get number of data items (2 - part name and visibility string) in this case.
+  /** Get number of data items (3 - part name, visibility and colour, or 1 for folders) in this case.
    * @return number of visible data columns
    */
   int columnCount() const;
 
+  /** Get the node table the item is kept in
+   * @return pointer to the store
+   */
+  ModelPartStore *store() const;
+
+  /** Get the item's id in its store
+   * @return node id
+   */
+  ModelPartStore::NodeId node() const;
+
   /** Return the data item at a particular column for this item.
    * i.e. either part name of visibility
    * used by Qt when displaying tree
@@ -143,6 +163,89 @@ public:
    */
   void loadSTL(QString fileName);
 
+  /** Read an STL file and weld its vertices into an indexed mesh
+   * @brief Does not touch any part or GUI state, so it is safe to call from a worker thread
+   * @param fileName is the name of the file to load
+   * @param weldTolerance is the distance within which vertices are merged, 0 merges identical vertices only
+   * @param cancelled is polled while reading, the result is discarded once it is set (may be null)
+   * @return the loaded mesh, with a null polydata if the file could not be read or loading was cancelled
+   */
+  static PartMesh readSTL(const QString &fileName, double weldTolerance = 0., const std::atomic_bool *cancelled = nullptr);
+
+  /** Read just enough of an STL file to show a placeholder for it
+   * @brief Uses the file's disk cache entry if it has one, otherwise the binary header and a sweep over the
+   * vertices for the bounds. ASCII files that haven't been cached have no header, so nothing is known about them.
+   * Safe to call from a worker thread
+   * @param fileName is the name of the file to read
+   * @param weldTolerance is the tolerance the file will be loaded with, used to find its cache entry
+   * @param header receives the triangle count and bounds
+   * @return false if the file could not be opened
+   */
+  static bool readSTLHeader(const QString &fileName, double weldTolerance, PartHeader &header);
+
+  /** Make this part a placeholder for a file whose geometry hasn't been loaded yet
+   * @brief The actor is a box around the part's bounds (if they are known) until setMesh() is called
+   * @param fileName is the file the geometry will be loaded from
+   * @param header is what is known about the file so far
+   */
+  void setPlaceholder(const QString &fileName, const PartHeader &header);
+
+  /** Set the part's geometry and build the GUI and VR actors for it
+   * @brief Parts given meshes from identical files end up sharing one polydata through the GeometryCache
+   * @param newMesh is the mesh to render (usually from readSTL())
+   */
+  void setMesh(const PartMesh &newMesh);
+
+  /** Check if the part's geometry has been loaded
+   * @return true once setMesh() has been called, false for placeholders
+   */
+  bool isResident() const;
+
+  /** Mark the part as waiting for its geometry
+   * @param loading is true while a load has been requested but hasn't finished
+   */
+  void setLoading(bool loading);
+
+  /** Check if the part is waiting for its geometry
+   * @return true while a load is in progress
+   */
+  bool isLoading() const;
+
+  /** Get the file the part's geometry comes from
+   * @return full path of the file, empty if the part has no file
+   */
+  QString filePath() const;
+
+  /** Get the number of triangles in the part
+   * @return triangle count of the mesh, or from the file's header for placeholders (0 if unknown)
+   */
+  vtkIdType triangleCount() const;
+
+  /** Set the welding tolerance used the next time loadSTL() is called
+   * @param tolerance is the distance within which vertices are merged, 0 merges identical vertices only
+   */
+  void setWeldTolerance(double tolerance);
+
+  /** Get the welding tolerance
+   * @return tolerance the current geometry was welded with (or will be, if nothing is loaded yet)
+   */
+  double weldTolerance() const;
+
+  /** Get the key of the part's mesh
+   * @return key the mesh is shared under, invalid if the geometry hasn't been loaded
+   */
+  GeometryKey geometryKey() const;
+
+  /** Get the number of vertices in the file before welding
+   * @return vertex count, 3 per triangle
+   */
+  vtkIdType vertexCountBeforeWeld() const;
+
+  /** Get the number of vertices after welding
+   * @return vertex count of the loaded mesh
+   */
+  vtkIdType vertexCountAfterWeld() const;
+
   /** Return actor
    * @return pointer to default actor for GUI rendering
    */
@@ -150,34 +253,64 @@ public:
 
   /**
    * @return pointer to actor for VR rendering
-   * @note Needs initialising with getNewActor() before use
+   * @note Created by setMesh(), it draws the same mesh as the GUI actor
    */
   vtkSmartPointer<vtkActor> getVRActor() const;
 
-  /** Return new actor for use in VR
-   * @return pointer to new actor
+  /** Return the unfiltered input of the VR actor
+   * @brief Shares its arrays with the part's mesh, used to take filters off the VR actor again
+   * @return pointer to the VR actor's polydata
    */
-  vtkActor *getNewActor();
+  vtkSmartPointer<vtkPolyData> getVRPolyData() const;
 
-  /** Set Original Data
-  * @param data is the original data to set
-  */
-  void setOriginalData(vtkSmartPointer<vtkDataSet> data);
+  /** Return a read-only view of the part's mesh for a filter to run on
+   * @brief It shares the mesh's arrays but nothing else reads it, so it can be handed to another thread
+   * @return pointer to the view, nullptr if the geometry hasn't been loaded
+   */
+  vtkSmartPointer<vtkPolyData> getFilterInput() const;
 
-  /** Get Original Data
-  * @return pointer to original data
-  */
-  vtkSmartPointer<vtkDataSet> getOriginalData();
+  /** Get the part's filter stack
+   * @return the filters shown on the VR actor, applied first to last
+   */
+  const std::vector<PartFilter> &filters() const;
+
+  /** Add a filter to the end of the stack
+   * @param filter is the filter to add
+   */
+  void pushFilter(const PartFilter &filter);
+
+  /** Change the parameters of one stage of the stack
+   * @param stage is the position of the filter, 0 for the first
+   * @param filter is the filter to put there
+   */
+  void setFilter(int stage, const PartFilter &filter);
+
+  /** Remove the last filter of the stack
+   * @return false if the stack was empty
+   */
+  bool popFilter();
+
+  /** Remove every filter from the stack
+   */
+  void clearFilters();
 
 private:
-  QList<ModelPart *> m_childItems; /**< List (array) of child items */
-  QList<QVariant> m_itemData;      /**< List (array of column data for item */
-  ModelPart *m_parentItem;         /**< Pointer to parent */
+  ModelPartStore *m_store;         /**< Node table holding the item's properties and tree links */
+  ModelPartStore::NodeId m_node;   /**< The item's node in m_store */
 
-  bool folderFlag; /**< True if this item is a folder */
+  double m_weldTolerance;            /**< Tolerance used to weld the vertices of the mesh */
+  vtkIdType m_vertexCountBeforeWeld; /**< Number of vertices in the file */
+  vtkIdType m_vertexCountAfterWeld;  /**< Number of vertices after welding */
+  GeometryKey m_geometryKey;         /**< Key of the shared mesh this part has claimed */
+
+  QString m_filePath;         /**< File the geometry was (or will be) loaded from */
+  vtkIdType m_triangleCount;  /**< Number of triangles in the mesh */
+  bool m_resident;            /**< True once the geometry has been loaded */
+  bool m_loading;             /**< True while the geometry is being loaded */
+  std::vector<PartFilter> m_filters; /**< Filters shown on the VR actor, first to last */
 
   /* These are some part properties */
-  /*NB: DO NOT USE THESE: m_itemData contains the data in the order name,visible, colour. DO NOT USE MULTIPLE VARIABLES FOR THE SAME INFORMATION*/
+  /*NB: DO NOT USE THESE: m_store holds the name, visibility and colour. DO NOT USE MULTIPLE VARIABLES FOR THE SAME INFORMATION*/
 
   // bool                                        isVisible;          /**< True/false to indicate if should be visible in model rendering */
   // QColor 								        QtColour;             /**< Colour of part */
@@ -185,14 +318,13 @@ private:
 
   /* These are vtk properties that will be used to load/render a model of this part */
 
-  vtkSmartPointer<vtkSTLReader> file;  /**< Datafile from which part loaded */
+  vtkSmartPointer<vtkPolyData> polyData; /**< Geometry loaded from file, shared and never modified */
+  vtkSmartPointer<vtkPolyData> VRPolyData; /**< Unfiltered input of the VR actor, shares the arrays of polyData */
   vtkSmartPointer<vtkMapper> mapper;   /**< Mapper for rendering */
   vtkSmartPointer<vtkMapper> VRMapper; /**< Mapper for rendering in VR*/
   vtkSmartPointer<vtkActor> actor;     /**< Actor for rendering */
   vtkSmartPointer<vtkActor> VRActor;   /**< Actor for rendering in VR*/
   vtkColor3<unsigned char> vtkColour;  /**< User defineable colour */
-
-  vtkSmartPointer<vtkDataSet> originalData; /**< Original data from file */
 };
 
 #endif
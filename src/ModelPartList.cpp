@@ -15,7 +15,8 @@ ModelPartList::ModelPartList(const QString &data, QObject *parent) : QAbstractIt
     /* Have option to specify number of visible properties for each item in tree - the root item
      * acts as the column headers
      */
-    rootItem = new ModelPart({tr("Part"), tr("Visible?"), tr("Colour")});
+    headers << tr("Part") << tr("Visible?") << tr("Colour");
+    rootItem = new ModelPart(&store, {QString()});
 }
 
 ModelPartList::~ModelPartList()
@@ -27,7 +28,7 @@ int ModelPartList::columnCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
 
-    return rootItem->columnCount();
+    return headers.size();
 }
 
 QVariant ModelPartList::data(const QModelIndex &index, int role) const
@@ -37,20 +38,51 @@ QVariant ModelPartList::data(const QModelIndex &index, int role) const
     if (!index.isValid())
         return QVariant();
 
-    /* Role represents what this data will be used for, we only need deal with the case
-     * when QT is asking for data to create and display the treeview. Return a new,
+    /* Get a a pointer to the item referred to by the QModelIndex */
+    ModelPart *item = static_cast<ModelPart *>(index.internalPointer());
+
+    /* Parts whose geometry hasn't been loaded yet are greyed out, and the tooltip
+     * says whether they are loaded */
+    if (role == Qt::ForegroundRole && !item->isFolder() && !item->isResident())
+        return QColor(Qt::gray);
+
+    if (role == Qt::ToolTipRole && !item->isFolder())
+    {
+        if (item->isResident())
+            return tr("Loaded: %1 triangles, %2 vertices").arg(item->triangleCount()).arg(item->vertexCountAfterWeld());
+        if (item->isLoading())
+            return tr("Loading...");
+        if (item->triangleCount() > 0)
+            return tr("Not loaded: %1 triangles").arg(item->triangleCount());
+        return tr("Not loaded");
+    }
+
+    /* Role represents what this data will be used for, otherwise we only need deal with
+     * the case when QT is asking for data to create and display the treeview. Return a new,
      * empty QVariant if any other request comes through. */
     if (role != Qt::DisplayRole)
         return QVariant();
 
-    /* Get a a pointer to the item referred to by the QModelIndex */
-    ModelPart *item = static_cast<ModelPart *>(index.internalPointer());
-
     /* Each item in the tree has a number of columns ("Part" and "Visible" in this
      * initial example) return the column requested by the QModelIndex */
     return item->data(index.column());
 }
 
+bool ModelPartList::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || role != Qt::EditRole)
+        return false;
+
+    ModelPart *item = static_cast<ModelPart *>(index.internalPointer());
+    if (index.column() >= item->columnCount())
+        return false;
+
+    item->set(index.column(), value);
+    emit dataChanged(index, index);
+
+    return true;
+}
+
 Qt::ItemFlags ModelPartList::flags(const QModelIndex &index) const
 {
     if (!index.isValid())
@@ -62,7 +94,7 @@ Qt::ItemFlags ModelPartList::flags(const QModelIndex &index) const
 QVariant ModelPartList::headerData(int section, Qt::Orientation orientation, int role) const
 {
     if (orientation == Qt::Horizontal && role == Qt::DisplayRole)
-        return rootItem->data(section);
+        return headers.value(section);
 
     return QVariant();
 }
@@ -116,31 +148,42 @@ ModelPart *ModelPartList::getRootItem()
     return rootItem;
 }
 
-QModelIndex ModelPartList::appendChild(QModelIndex &parent, const QList<QVariant> &data)
+QModelIndex ModelPartList::appendChild(const QModelIndex &parent, const QList<QVariant> &data)
 {
-    ModelPart *parentPart;
+    QList<ModelPart *> parts = appendChildren(parent, QList<QList<QVariant>>() << data);
 
-    if (parent.isValid())
-        parentPart = static_cast<ModelPart *>(parent.internalPointer());
-    else
-    {
-        parentPart = rootItem;
-        parent = createIndex(0, 0, rootItem);
-    }
+    return createIndex(parts.first()->row(), 0, parts.first());
+}
 
-    beginInsertRows(parent, rowCount(parent), rowCount(parent));
+QList<ModelPart *> ModelPartList::appendChildren(const QModelIndex &parent, const QList<QList<QVariant>> &data)
+{
+    QList<ModelPart *> parts;
+    if (data.isEmpty())
+        return parts;
 
-    ModelPart *childPart = new ModelPart(data, parentPart);
+    /* Top level items go under the root item, which has no index of its own */
+    ModelPart *parentPart = parent.isValid() ? static_cast<ModelPart *>(parent.internalPointer()) : rootItem;
+    int first = parentPart->childCount();
 
-    parentPart->appendChild(childPart);
+    /* The rows are only appended, nothing moves, so this doesn't need a layout change */
+    beginInsertRows(parent, first, first + data.size() - 1);
 
-    QModelIndex child = createIndex(0, 0, childPart);
+    parts.reserve(data.size());
+    for (const QList<QVariant> &itemData : data)
+    {
+        ModelPart *childPart = new ModelPart(&store, itemData);
+        parentPart->appendChild(childPart);
+        parts.append(childPart);
+    }
 
     endInsertRows();
 
-    emit layoutChanged();
+    return parts;
+}
 
-    return child;
+qint64 ModelPartList::memoryUsage() const
+{
+    return store.memoryUsage();
 }
 
 bool ModelPartList::removeRow(int row, const QModelIndex &parent)
@@ -154,6 +197,7 @@ bool ModelPartList::removeRow(int row, const QModelIndex &parent)
     {
 
         ModelPart *childPart = rootItem->child(row);
+        forgetActors(childPart);
         rootItem->removeChild(childPart);
         delete childPart;
         endRemoveRows();
@@ -161,6 +205,7 @@ bool ModelPartList::removeRow(int row, const QModelIndex &parent)
     }
 
     ModelPart *childPart = parentPart->child(row);
+    forgetActors(childPart);
     parentPart->removeChild(childPart);
     endRemoveRows();
     delete childPart;
@@ -168,24 +213,43 @@ bool ModelPartList::removeRow(int row, const QModelIndex &parent)
     return true;
 }
 
-QModelIndex ModelPartList::index(ModelPart *part, const QModelIndex &parent = QModelIndex())
+QModelIndex ModelPartList::index(ModelPart *part) const
+{
+    if (part == nullptr || part == rootItem || part->store() != &store)
+        return QModelIndex();
+
+    return createIndex(part->row(), 0, part);
+}
+
+void ModelPartList::updateActor(ModelPart *part)
 {
-    for (int i = 0; i < rowCount(parent); ++i)
+    vtkActor *previous = partActors.take(part);
+    if (previous)
+        actorParts.remove(previous);
+
+    vtkActor *actor = part->getActor();
+    if (actor)
     {
-        QModelIndex current = index(i, 0, parent);
-        ModelPart *currentPart = static_cast<ModelPart *>(current.internalPointer());
-        if (currentPart == part)
-        {
-            return current;
-        }
-        if (hasChildren(current))
-        {
-            QModelIndex found = index(part, current);
-            if (found.isValid())
-            {
-                return found;
-            }
-        }
+        actorParts.insert(actor, part);
+        partActors.insert(part, actor);
     }
-    return QModelIndex();
-}
\ No newline at end of file
+
+    QModelIndex partIndex = index(part);
+    if (partIndex.isValid())
+        emit dataChanged(partIndex, partIndex.siblingAtColumn(part->columnCount() - 1));
+}
+
+ModelPart *ModelPartList::partFromActor(vtkActor *actor) const
+{
+    return actorParts.value(actor, nullptr);
+}
+
+void ModelPartList::forgetActors(ModelPart *part)
+{
+    for (int i = 0; i < part->childCount(); i++)
+        forgetActors(part->child(i));
+
+    vtkActor *actor = partActors.take(part);
+    if (actor)
+        actorParts.remove(actor);
+}
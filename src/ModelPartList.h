@@ -19,6 +19,8 @@
 #include <QVariant>
 #include <QString>
 #include <QList>
+#include <QStringList>
+#include <QHash>
 
 class ModelPart;
 
@@ -59,6 +61,15 @@ class ModelPartList : public QAbstractItemModel
    */
   QVariant data(const QModelIndex &index, int role) const;
 
+  /**
+   * @brief Change one property (column) of an item and tell the views and the scene about it
+   * @param index the item and column to change
+   * @param value the new value
+   * @param role must be Qt::EditRole
+   * @return true if the item was changed
+   */
+  bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
+
   /**
    * @brief Standard function used by Qt internally.
    * @param index in a stucture Qt uses to specify the row and column it wants data for
@@ -110,7 +121,22 @@ class ModelPartList : public QAbstractItemModel
    * @param parent the parent index
    * @param data the data to append
    */
-  QModelIndex appendChild(QModelIndex &parent, const QList<QVariant> &data);
+  QModelIndex appendChild(const QModelIndex &parent, const QList<QVariant> &data);
+
+  /**
+   * @brief Add several items under one parent
+   * @brief Views are told about the whole row range at once, so adding thousands of parts is one update
+   * @param parent the parent index (invalid for the top level)
+   * @param data the column data of each new item
+   * @return the new items, in row order
+   */
+  QList<ModelPart *> appendChildren(const QModelIndex &parent, const QList<QList<QVariant>> &data);
+
+  /**
+   * @brief Get the memory used by the tree's node store
+   * @return size in bytes
+   */
+  qint64 memoryUsage() const;
 
   /**
    * @brief Remove a row from the tree
@@ -121,14 +147,59 @@ class ModelPartList : public QAbstractItemModel
   bool removeRow(int row, const QModelIndex &parent);
 
   /**
-   * @brief Get the index of the root item from the part
-   * @return the index of the root item
-   * @param part the model part
-   * @param parent the parent index
+   * @brief Get the index of a part
+   * @brief Built from the part's maintained row, so it costs the same however big the tree is
+   * @param part the model part (may be nullptr)
+   * @return the index of the part's first column, invalid for nullptr, the root or a part from another list
+   */
+  QModelIndex index(ModelPart *part) const;
+
+  /**
+   * @brief Record the actor a part is currently drawn with, so picking it can find the part
+   * @brief Call whenever the part's actor changes (setMesh(), setPlaceholder()...), the row is reported
+   * as changed so the scene swaps the actors
+   * @param part the model part, its previous actor is forgotten
    */
-  QModelIndex index(ModelPart *part, const QModelIndex &parent);
+  void updateActor(ModelPart *part);
+
+  /**
+   * @brief Find the part an actor belongs to
+   * @param actor the picked actor
+   * @return the part, nullptr if the actor isn't one of the list's parts
+   */
+  ModelPart *partFromActor(vtkActor *actor) const;
 
 private:
+  /**
+   * @brief Node table holding the name, flags, colour and tree links of every item
+   *
+   */
+  ModelPartStore store;
+
+  /**
+   * @brief Column titles
+   *
+   */
+  QStringList headers;
+
+  /**
+   * @brief Forget the actors of a part and everything below it
+   * @param part the part being removed
+   */
+  void forgetActors(ModelPart *part);
+
+  /**
+   * @brief Part drawn by each actor
+   *
+   */
+  QHash<vtkActor *, ModelPart *> actorParts;
+
+  /**
+   * @brief Actor registered for each part, so it can be forgotten when the part's actor changes
+   *
+   */
+  QHash<ModelPart *, vtkActor *> partActors;
+
   /**
    * @brief Pointer to the root item of the tree
    *
@@ -0,0 +1,211 @@
+/**     @file ModelPartStore.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ */
+
+#include "ModelPartStore.h"
+
+namespace
+{
+    /* Block table entries reserved up front (16M nodes), so looking up a block never races
+     * with the table being reallocated while the tree grows
+     */
+    const std::size_t reservedBlocks = 1 << 14;
+}
+
+ModelPartStore::ModelPartStore()
+    : nextUnused(0), liveNodes(0)
+{
+    blocks.reserve(reservedBlocks);
+}
+
+ModelPartStore::~ModelPartStore()
+{
+}
+
+ModelPartStore::NodeId ModelPartStore::create(const QString &name, quint8 flags, QRgb colour, ModelPart *part)
+{
+    NodeId node;
+    if (!freeNodes.empty())
+    {
+        node = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else
+    {
+        node = nextUnused++;
+        if ((std::size_t(node) >> blockBits) >= blocks.size())
+            blocks.emplace_back(new Block);
+    }
+
+    Block &b = block(node);
+    int i = node & (blockSize - 1);
+    b.names[i] = name;
+    b.flags[i] = flags;
+    b.colours[i] = colour;
+    b.parents[i] = NoNode;
+    b.children[i].clear();
+    b.rows[i] = 0;
+    b.parts[i] = part;
+
+    liveNodes++;
+    return node;
+}
+
+void ModelPartStore::destroy(NodeId node)
+{
+    if (node == NoNode)
+        return;
+
+    /* Release the name's and child array's memory now rather than when the id is reused */
+    Block &b = block(node);
+    int i = node & (blockSize - 1);
+    b.names[i] = QString();
+    std::vector<NodeId>().swap(b.children[i]);
+    b.parts[i] = nullptr;
+
+    freeNodes.push_back(node);
+    liveNodes--;
+}
+
+void ModelPartStore::appendChild(NodeId parent, NodeId child)
+{
+    std::vector<NodeId> &siblings = block(parent).children[parent & (blockSize - 1)];
+
+    Block &c = block(child);
+    int ci = child & (blockSize - 1);
+    c.parents[ci] = parent;
+    c.rows[ci] = qint32(siblings.size());
+
+    siblings.push_back(child);
+}
+
+void ModelPartStore::detach(NodeId node)
+{
+    Block &b = block(node);
+    int i = node & (blockSize - 1);
+
+    NodeId parent = b.parents[i];
+    if (parent == NoNode)
+        return;
+
+    std::vector<NodeId> &siblings = block(parent).children[parent & (blockSize - 1)];
+    std::size_t row = std::size_t(b.rows[i]);
+    siblings.erase(siblings.begin() + row);
+
+    /* Everything after the node moves up a row */
+    for (std::size_t r = row; r < siblings.size(); r++)
+    {
+        NodeId n = siblings[r];
+        block(n).rows[n & (blockSize - 1)] = qint32(r);
+    }
+
+    b.parents[i] = NoNode;
+    b.rows[i] = 0;
+}
+
+const QString &ModelPartStore::name(NodeId node) const
+{
+    return block(node).names[node & (blockSize - 1)];
+}
+
+void ModelPartStore::setName(NodeId node, const QString &name)
+{
+    block(node).names[node & (blockSize - 1)] = name;
+}
+
+bool ModelPartStore::testFlag(NodeId node, Flag flag) const
+{
+    return (block(node).flags[node & (blockSize - 1)] & flag) != 0;
+}
+
+void ModelPartStore::setFlag(NodeId node, Flag flag, bool on)
+{
+    quint8 &flags = block(node).flags[node & (blockSize - 1)];
+    if (on)
+        flags |= flag;
+    else
+        flags &= quint8(~flag);
+}
+
+QRgb ModelPartStore::colour(NodeId node) const
+{
+    return block(node).colours[node & (blockSize - 1)];
+}
+
+void ModelPartStore::setColour(NodeId node, QRgb colour)
+{
+    block(node).colours[node & (blockSize - 1)] = colour;
+}
+
+ModelPart *ModelPartStore::part(NodeId node) const
+{
+    if (node == NoNode)
+        return nullptr;
+    return block(node).parts[node & (blockSize - 1)];
+}
+
+ModelPartStore::NodeId ModelPartStore::parent(NodeId node) const
+{
+    return block(node).parents[node & (blockSize - 1)];
+}
+
+ModelPartStore::NodeId ModelPartStore::firstChild(NodeId node) const
+{
+    const std::vector<NodeId> &children = block(node).children[node & (blockSize - 1)];
+    return children.empty() ? NoNode : children.front();
+}
+
+ModelPartStore::NodeId ModelPartStore::lastChild(NodeId node) const
+{
+    const std::vector<NodeId> &children = block(node).children[node & (blockSize - 1)];
+    return children.empty() ? NoNode : children.back();
+}
+
+ModelPartStore::NodeId ModelPartStore::nextSibling(NodeId node) const
+{
+    NodeId parent = this->parent(node);
+    if (parent == NoNode)
+        return NoNode;
+    return child(parent, row(node) + 1);
+}
+
+int ModelPartStore::childCount(NodeId node) const
+{
+    return int(block(node).children[node & (blockSize - 1)].size());
+}
+
+ModelPartStore::NodeId ModelPartStore::child(NodeId parent, int row) const
+{
+    const std::vector<NodeId> &children = block(parent).children[parent & (blockSize - 1)];
+    if (row < 0 || std::size_t(row) >= children.size())
+        return NoNode;
+    return children[std::size_t(row)];
+}
+
+int ModelPartStore::row(NodeId node) const
+{
+    return block(node).rows[node & (blockSize - 1)];
+}
+
+int ModelPartStore::nodeCount() const
+{
+    return liveNodes;
+}
+
+qint64 ModelPartStore::memoryUsage() const
+{
+    qint64 bytes = qint64(sizeof(*this)) + qint64(blocks.capacity() * sizeof(blocks[0])) +
+                   qint64(freeNodes.capacity() * sizeof(NodeId)) + qint64(blocks.size() * sizeof(Block));
+
+    /* Names that aren't empty and nodes with children have their own heap buffer (its small header isn't counted) */
+    for (NodeId node = 0; node < nextUnused; node++)
+    {
+        const QString &n = name(node);
+        if (!n.isNull())
+            bytes += qint64(n.capacity() + 1) * qint64(sizeof(QChar));
+        bytes += qint64(block(node).children[node & (blockSize - 1)].capacity() * sizeof(NodeId));
+    }
+    return bytes;
+}
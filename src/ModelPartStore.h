@@ -0,0 +1,233 @@
+/**     @file ModelPartStore.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief Compact table holding the tree structure and properties of every model part
+ */
+
+#ifndef VIEWER_MODELPARTSTORE_H
+#define VIEWER_MODELPARTSTORE_H
+
+#include <QString>
+#include <QRgb>
+
+#include <memory>
+#include <vector>
+
+class ModelPart;
+
+/**
+ * @class ModelPartStore
+ * @brief Struct-of-arrays node table behind the model tree
+ *
+ * Every node has a name, a byte of flags (visible, folder...), a packed RGBA colour, its parent,
+ * the ids of its children in order, its row among its siblings and a handle to the ModelPart holding
+ * its rendering state. Each field lives in its own array so a walk over one property (e.g. the
+ * visibility of every part) only touches that property's memory, and nothing is wrapped in a QVariant.
+ *
+ * The arrays are split into blocks of 1024 nodes that are never moved once allocated, so the fields
+ * of a node stay at the same address while the tree grows. Ids of deleted nodes are reused.
+ */
+class ModelPartStore
+{
+public:
+    /** Index of a node in the store */
+    typedef qint32 NodeId;
+
+    /** Id used for "no node" (e.g. the parent of the root) */
+    static const NodeId NoNode = -1;
+
+    /** Bits of a node's flags */
+    enum Flag : quint8
+    {
+        Visible = 0x1,  /**< The part is drawn */
+        Folder = 0x2,   /**< The node is a folder rather than a part */
+        NameOnly = 0x4  /**< The node only has a name column (folders) */
+    };
+
+    /**
+     * @brief Constructor
+     */
+    ModelPartStore();
+
+    /**
+     * @brief Destructor
+     */
+    ~ModelPartStore();
+
+    /**
+     * @brief Add a node that isn't in the tree yet
+     * @param name The node's name
+     * @param flags Combination of Flag bits
+     * @param colour The node's colour
+     * @param part The ModelPart the node belongs to
+     * @return id of the new node
+     */
+    NodeId create(const QString &name, quint8 flags, QRgb colour, ModelPart *part);
+
+    /**
+     * @brief Free a node so its id can be reused
+     * @param node A node that has been detached from its parent, its children are not touched
+     */
+    void destroy(NodeId node);
+
+    /**
+     * @brief Make a node the last child of another
+     * @param parent The new parent
+     * @param child A node that has no parent
+     */
+    void appendChild(NodeId parent, NodeId child);
+
+    /**
+     * @brief Remove a node from its parent's children
+     * @brief The children after it move up a row, so detaching the last child is the cheap case
+     * @param node The node to detach, its own children stay attached to it
+     */
+    void detach(NodeId node);
+
+    /**
+     * @brief Get a node's name
+     * @param node The node
+     * @return the name
+     */
+    const QString &name(NodeId node) const;
+
+    /**
+     * @brief Set a node's name
+     * @param node The node
+     * @param name The new name
+     */
+    void setName(NodeId node, const QString &name);
+
+    /**
+     * @brief Check one of a node's flags
+     * @param node The node
+     * @param flag The flag to check
+     * @return true if the flag is set
+     */
+    bool testFlag(NodeId node, Flag flag) const;
+
+    /**
+     * @brief Set or clear one of a node's flags
+     * @param node The node
+     * @param flag The flag to change
+     * @param on True to set the flag
+     */
+    void setFlag(NodeId node, Flag flag, bool on);
+
+    /**
+     * @brief Get a node's colour
+     * @param node The node
+     * @return the colour packed as 0xAARRGGBB
+     */
+    QRgb colour(NodeId node) const;
+
+    /**
+     * @brief Set a node's colour
+     * @param node The node
+     * @param colour The colour packed as 0xAARRGGBB
+     */
+    void setColour(NodeId node, QRgb colour);
+
+    /**
+     * @brief Get the ModelPart a node belongs to
+     * @param node The node (NoNode is allowed)
+     * @return the part, nullptr for NoNode
+     */
+    ModelPart *part(NodeId node) const;
+
+    /**
+     * @brief Get a node's parent
+     * @param node The node
+     * @return the parent, NoNode for the root or a detached node
+     */
+    NodeId parent(NodeId node) const;
+
+    /**
+     * @brief Get a node's first child
+     * @param node The node
+     * @return the first child, NoNode if there are none
+     */
+    NodeId firstChild(NodeId node) const;
+
+    /**
+     * @brief Get a node's last child
+     * @param node The node
+     * @return the last child, NoNode if there are none
+     */
+    NodeId lastChild(NodeId node) const;
+
+    /**
+     * @brief Get the next child of a node's parent
+     * @param node The node
+     * @return the next sibling, NoNode for the last child
+     */
+    NodeId nextSibling(NodeId node) const;
+
+    /**
+     * @brief Get the number of children of a node
+     * @param node The node
+     * @return number of children
+     */
+    int childCount(NodeId node) const;
+
+    /**
+     * @brief Get a child of a node by position
+     * @brief A single lookup in the parent's child array
+     * @param parent The parent
+     * @param row Position of the child
+     * @return the child, NoNode if row is out of range
+     */
+    NodeId child(NodeId parent, int row) const;
+
+    /**
+     * @brief Get the position of a node among its parent's children
+     * @brief Rows are kept up to date as children are added and removed, so this is a single lookup
+     * @param node The node
+     * @return the row, 0 for a node with no parent
+     */
+    int row(NodeId node) const;
+
+    /**
+     * @brief Get the number of nodes in use
+     * @return node count
+     */
+    int nodeCount() const;
+
+    /**
+     * @brief Get the memory used by the store, including the heap memory of the names
+     * @return size in bytes
+     */
+    qint64 memoryUsage() const;
+
+private:
+    /** Nodes per block, a power of two */
+    static const int blockBits = 10;
+    static const int blockSize = 1 << blockBits;
+
+    /** One block of each node array */
+    struct Block
+    {
+        QString names[blockSize];
+        quint8 flags[blockSize];
+        QRgb colours[blockSize];
+        NodeId parents[blockSize];
+        std::vector<NodeId> children[blockSize];
+        qint32 rows[blockSize];
+        ModelPart *parts[blockSize];
+    };
+
+    /**
+     * @brief Get the block holding a node
+     * @param node The node
+     * @return the block, the node's slot in it is node & (blockSize - 1)
+     */
+    Block &block(NodeId node) const { return *blocks[std::size_t(node) >> blockBits]; }
+
+    std::vector<std::unique_ptr<Block>> blocks; /**< Node arrays, reserved up front so the table never moves */
+    std::vector<NodeId> freeNodes;              /**< Ids of destroyed nodes, reused first */
+    NodeId nextUnused;                          /**< Lowest id that has never been used */
+    int liveNodes;                              /**< Number of nodes in use */
+};
+
+#endif
@@ -0,0 +1,69 @@
+/**     @file OpenVRBackend.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ */
+
+#include "OpenVRBackend.h"
+
+bool OpenVRBackend::initialise()
+{
+	// The renderer generates the image
+	// which is then displayed on the render window.
+	// It can be thought of as a scene to which the actor is added
+	vrRenderer = vtkSmartPointer<vtkOpenVRRenderer>::New();
+
+	/* The render window is the actual GUI window
+	 * that appears on the computer screen
+	 */
+	window = vtkSmartPointer<vtkOpenVRRenderWindow>::New();
+
+	if (!window->IsHMDPresent())
+	{
+		message = "No HMD detected";
+		return false;
+	}
+
+	window->Initialize();
+	window->AddRenderer(vrRenderer);
+
+	/* Create Open VR Camera */
+	camera = vtkSmartPointer<vtkOpenVRCamera>::New();
+	vrRenderer->SetActiveCamera(camera);
+
+	/* The render window interactor captures mouse events
+	 * and will perform appropriate camera or actor manipulation
+	 * depending on the nature of the events.
+	 */
+	interactor = vtkSmartPointer<vtkOpenVRRenderWindowInteractor>::New();
+	interactor->SetRenderWindow(window);
+	interactor->Initialize();
+	window->Render();
+
+	return true;
+}
+
+vtkRenderer *OpenVRBackend::renderer()
+{
+	return vrRenderer;
+}
+
+void OpenVRBackend::doOneFrame()
+{
+	interactor->DoOneEvent(window, vrRenderer);
+}
+
+bool OpenVRBackend::isDone()
+{
+	return interactor->GetDone();
+}
+
+void OpenVRBackend::finalise()
+{
+	window->Finalize();
+}
+
+QString OpenVRBackend::error() const
+{
+	return message;
+}
@@ -0,0 +1,44 @@
+/**     @file OpenVRBackend.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief Draws the VR scene to an OpenVR headset
+ */
+
+#ifndef VIEWER_OPENVRBACKEND_H
+#define VIEWER_OPENVRBACKEND_H
+
+#include "VRBackend.h"
+
+#include <vtkSmartPointer.h>
+#include <vtkOpenVRRenderWindow.h>
+#include <vtkOpenVRRenderWindowInteractor.h>
+#include <vtkOpenVRRenderer.h>
+#include <vtkOpenVRCamera.h>
+
+/**
+ * @class OpenVRBackend
+ * @brief Renders to the headset through VTK's OpenVR classes
+ */
+class OpenVRBackend : public VRBackend
+{
+public:
+  bool initialise() override;
+  vtkRenderer *renderer() override;
+  void doOneFrame() override;
+  bool isDone() override;
+  void finalise() override;
+  QString error() const override;
+
+private:
+  /** @brief Standard VTK VR Classes */
+  vtkSmartPointer<vtkOpenVRRenderWindow> window;
+  vtkSmartPointer<vtkOpenVRRenderWindowInteractor> interactor;
+  vtkSmartPointer<vtkOpenVRRenderer> vrRenderer;
+  vtkSmartPointer<vtkOpenVRCamera> camera;
+
+  /** @brief Why initialise() failed */
+  QString message;
+};
+
+#endif
@@ -0,0 +1,151 @@
+/**     @file PartFilter.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ */
+
+#include "PartFilter.h"
+
+#include <vtkCallbackCommand.h>
+#include <vtkClipPolyData.h>
+#include <vtkPlane.h>
+#include <vtkQuadricDecimation.h>
+#include <vtkShrinkPolyData.h>
+#include <vtkSmoothPolyDataFilter.h>
+
+namespace
+{
+    /* What the progress observer needs to know about the filter it watches */
+    struct ProgressState
+    {
+        const std::atomic_bool *cancelled;
+        const std::function<void(double)> *progress;
+    };
+
+    void onProgress(vtkObject *caller, unsigned long, void *clientData, void *callData)
+    {
+        ProgressState *state = static_cast<ProgressState *>(clientData);
+        vtkAlgorithm *algorithm = static_cast<vtkAlgorithm *>(caller);
+
+        /* VTK filters check this flag between chunks of work */
+        if (state->cancelled && *state->cancelled)
+            algorithm->SetAbortExecute(1);
+
+        if (*state->progress)
+            (*state->progress)(*static_cast<double *>(callData));
+    }
+}
+
+PartFilter PartFilter::shrink(double factor)
+{
+    PartFilter filter;
+    filter.type = Shrink;
+    filter.parameters[0] = factor;
+    return filter;
+}
+
+PartFilter PartFilter::clip(const double origin[3], const double normal[3])
+{
+    PartFilter filter;
+    filter.type = Clip;
+    for (int i = 0; i < 3; i++)
+    {
+        filter.parameters[i] = origin[i];
+        filter.parameters[3 + i] = normal[i];
+    }
+    return filter;
+}
+
+PartFilter PartFilter::decimate(double reduction)
+{
+    PartFilter filter;
+    filter.type = Decimate;
+    filter.parameters[0] = reduction;
+    return filter;
+}
+
+PartFilter PartFilter::smooth(int iterations, double relaxation)
+{
+    PartFilter filter;
+    filter.type = Smooth;
+    filter.parameters[0] = iterations;
+    filter.parameters[1] = relaxation;
+    return filter;
+}
+
+QString PartFilter::describe() const
+{
+    switch (type)
+    {
+    case Shrink:
+        return QString("Shrink %1").arg(parameters[0]);
+    case Clip:
+        return QString("Clip (%1, %2, %3)").arg(parameters[3]).arg(parameters[4]).arg(parameters[5]);
+    case Decimate:
+        return QString("Decimate %1%").arg(parameters[0] * 100.);
+    case Smooth:
+        return QString("Smooth x%1").arg(int(parameters[0]));
+    }
+    return QString();
+}
+
+vtkSmartPointer<vtkPolyData> PartFilter::apply(vtkPolyData *input, const std::atomic_bool *cancelled,
+                                               const std::function<void(double)> &progress) const
+{
+    if (cancelled && *cancelled)
+        return nullptr;
+
+    /* The polydata versions of the filters are used so their output can go straight into another filter */
+    vtkSmartPointer<vtkPolyDataAlgorithm> algorithm;
+    switch (type)
+    {
+    case Shrink:
+    {
+        vtkSmartPointer<vtkShrinkPolyData> shrinkFilter = vtkSmartPointer<vtkShrinkPolyData>::New();
+        shrinkFilter->SetShrinkFactor(parameters[0]);
+        algorithm = shrinkFilter;
+        break;
+    }
+    case Clip:
+    {
+        vtkSmartPointer<vtkPlane> plane = vtkSmartPointer<vtkPlane>::New();
+        plane->SetOrigin(parameters[0], parameters[1], parameters[2]);
+        plane->SetNormal(parameters[3], parameters[4], parameters[5]);
+
+        vtkSmartPointer<vtkClipPolyData> clipFilter = vtkSmartPointer<vtkClipPolyData>::New();
+        clipFilter->SetClipFunction(plane);
+        algorithm = clipFilter;
+        break;
+    }
+    case Decimate:
+    {
+        vtkSmartPointer<vtkQuadricDecimation> decimateFilter = vtkSmartPointer<vtkQuadricDecimation>::New();
+        decimateFilter->SetTargetReduction(parameters[0]);
+        algorithm = decimateFilter;
+        break;
+    }
+    case Smooth:
+    {
+        vtkSmartPointer<vtkSmoothPolyDataFilter> smoothFilter = vtkSmartPointer<vtkSmoothPolyDataFilter>::New();
+        smoothFilter->SetNumberOfIterations(int(parameters[0]));
+        smoothFilter->SetRelaxationFactor(parameters[1]);
+        algorithm = smoothFilter;
+        break;
+    }
+    }
+
+    ProgressState state = {cancelled, &progress};
+    vtkSmartPointer<vtkCallbackCommand> observer = vtkSmartPointer<vtkCallbackCommand>::New();
+    observer->SetCallback(onProgress);
+    observer->SetClientData(&state);
+    algorithm->AddObserver(vtkCommand::ProgressEvent, observer);
+
+    algorithm->SetInputData(input);
+    algorithm->Update();
+
+    if (cancelled && *cancelled)
+        return nullptr;
+
+    vtkSmartPointer<vtkPolyData> output = algorithm->GetOutput();
+    return output;
+}
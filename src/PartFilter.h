@@ -0,0 +1,90 @@
+/**     @file PartFilter.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief A filter that can be applied to the mesh of a part
+ */
+
+#ifndef VIEWER_PARTFILTER_H
+#define VIEWER_PARTFILTER_H
+
+#include <QString>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+/**
+ * @brief One filter and its parameters
+ *
+ * Filters read a mesh and produce a new polydata, the input is never modified. The meaning of the
+ * parameters depends on the type, use the named constructors to fill them in.
+ */
+struct PartFilter
+{
+  /** The kinds of filter */
+  enum Type
+  {
+    Shrink,   /**< Shrink each triangle towards its centre, parameters[0] is the shrink factor */
+    Clip,     /**< Cut away one side of a plane, parameters[0..2] is its origin and parameters[3..5] its normal */
+    Decimate, /**< Reduce the number of triangles, parameters[0] is the fraction to remove */
+    Smooth    /**< Relax the vertices, parameters[0] is the number of iterations and parameters[1] the relaxation factor */
+  };
+
+  Type type = Shrink;                             /**< Which filter to run */
+  double parameters[6] = {0., 0., 0., 0., 0., 0.}; /**< Settings of the filter, see Type */
+
+  /** Compare two filters
+   * @param other is the filter to compare with
+   * @return true if both filters are of the same type with the same parameters
+   */
+  bool operator==(const PartFilter &other) const
+  {
+    return type == other.type && std::equal(parameters, parameters + 6, other.parameters);
+  }
+
+  /** Make a shrink filter
+   * @param factor is the size of each triangle afterwards relative to before (0 to 1)
+   * @return the filter
+   */
+  static PartFilter shrink(double factor);
+
+  /** Make a clip filter
+   * @param origin is a point on the plane
+   * @param normal is the plane's normal, the side it points to is kept
+   * @return the filter
+   */
+  static PartFilter clip(const double origin[3], const double normal[3]);
+
+  /** Make a decimate filter
+   * @param reduction is the fraction of triangles to remove (0 to 1)
+   * @return the filter
+   */
+  static PartFilter decimate(double reduction);
+
+  /** Make a smooth filter
+   * @param iterations is the number of smoothing passes
+   * @param relaxation is how far each vertex moves towards its neighbours per pass (0 to 1)
+   * @return the filter
+   */
+  static PartFilter smooth(int iterations, double relaxation);
+
+  /** Get a short description of the filter for the GUI
+   * @return the filter's name and parameters
+   */
+  QString describe() const;
+
+  /** Run the filter, safe to call on a worker thread
+   * @param input is the mesh to filter, it must not be used by any other thread while the filter runs
+   * @param cancelled is checked as the filter runs, if it becomes true the filter gives up early
+   * @param progress is called from time to time with the fraction done (0 to 1), may be empty
+   * @return the filtered mesh, nullptr if the filter was cancelled
+   */
+  vtkSmartPointer<vtkPolyData> apply(vtkPolyData *input, const std::atomic_bool *cancelled = nullptr,
+                                     const std::function<void(double)> &progress = {}) const;
+};
+
+#endif
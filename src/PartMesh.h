@@ -0,0 +1,62 @@
+/**     @file PartMesh.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief Geometry read from an STL file and the key it is shared under
+ */
+
+#ifndef VIEWER_PARTMESH_H
+#define VIEWER_PARTMESH_H
+
+#include <QtGlobal>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+/**
+ * @brief Identifies a mesh by the content of the file it came from
+ */
+struct GeometryKey
+{
+  quint64 contentHash = 0;  /**< Hash of every byte in the file */
+  qint64 fileSize = 0;      /**< Size of the file in bytes, 0 if the key hasn't been set */
+  double weldTolerance = 0.; /**< Tolerance the vertices were welded with */
+
+  /** Check if the key has been set
+   * @return true if the key identifies a file
+   */
+  bool isValid() const { return fileSize > 0; }
+
+  /** Compare two keys
+   * @param other is the key to compare with
+   * @return true if both keys refer to the same mesh
+   */
+  bool operator==(const GeometryKey &other) const
+  {
+    return contentHash == other.contentHash && fileSize == other.fileSize && weldTolerance == other.weldTolerance;
+  }
+};
+
+/**
+ * @brief Geometry read from an STL file, along with how much welding reduced it
+ */
+struct PartMesh
+{
+  vtkSmartPointer<vtkPolyData> polyData; /**< The indexed mesh, nullptr if the file couldn't be read */
+  GeometryKey key;                       /**< Key the mesh is shared under in the GeometryCache */
+  double weldTolerance = 0.;             /**< Tolerance the vertices were welded with */
+  vtkIdType vertexCountBeforeWeld = 0;   /**< Number of vertices in the file (3 per triangle) */
+  vtkIdType vertexCountAfterWeld = 0;    /**< Number of vertices left after welding */
+};
+
+/**
+ * @brief What can be found out about an STL file without building its mesh
+ */
+struct PartHeader
+{
+  vtkIdType triangleCount = 0;    /**< Number of triangles, 0 if unknown (uncached ASCII files) */
+  double bounds[6] = {0., 0., 0., 0., 0., 0.}; /**< xmin, xmax, ymin, ymax, zmin, zmax */
+  bool hasBounds = false;         /**< True if bounds has been filled in */
+};
+
+#endif
@@ -0,0 +1,269 @@
+/**     @file RenderScene.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ */
+
+#include "RenderScene.h"
+#include "ModelPartList.h"
+#include "ModelPart.h"
+#include "VRRenderThread.h"
+
+#include <QTimer>
+#include <vtkProperty.h>
+
+RenderScene::RenderScene(ModelPartList *model, vtkRenderer *renderer, VRRenderThread *vrThread, QObject *parent)
+    : QObject(parent), model(model), renderer(renderer), vrThread(vrThread), renderPending(false), cameraPending(false)
+{
+    /* Faces the same way as the clip filter */
+    plane = vtkSmartPointer<vtkPlane>::New();
+    plane->SetOrigin(0, 0, 0);
+    plane->SetNormal(VRRenderThread::sectionNormal[0], VRRenderThread::sectionNormal[1], VRRenderThread::sectionNormal[2]);
+
+    connect(model, &QAbstractItemModel::rowsInserted, this, &RenderScene::handleRowsInserted);
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &RenderScene::handleRowsAboutToBeRemoved);
+    connect(model, &QAbstractItemModel::dataChanged, this, &RenderScene::handleDataChanged);
+    connect(model, &QAbstractItemModel::modelReset, this, &RenderScene::rebuild);
+}
+
+void RenderScene::resetCamera()
+{
+    cameraPending = true;
+    scheduleRender();
+}
+
+void RenderScene::rebuild()
+{
+    for (auto it = shown.begin(); it != shown.end(); ++it)
+        renderer->RemoveActor(it.value());
+    for (auto it = shownInVR.begin(); it != shownInVR.end(); ++it)
+        vrThread->removeActor(it.value());
+    shown.clear();
+    shownInVR.clear();
+
+    for (auto it = clipped.begin(); it != clipped.end(); ++it)
+        it.value()->RemoveClippingPlane(plane);
+    clipped.clear();
+    sectioned.clear();
+
+    for (int i = 0; i < model->rowCount(QModelIndex()); i++)
+        syncSubtree(model->index(i, 0, QModelIndex()));
+
+    scheduleRender();
+}
+
+void RenderScene::setSectioned(const QModelIndex &index, bool isSectioned)
+{
+    ModelPart *part = static_cast<ModelPart *>(index.internalPointer());
+    if (!part)
+        return;
+
+    if (isSectioned)
+        sectioned.insert(part);
+    else
+        sectioned.remove(part);
+    syncSection(part);
+
+    int rows = model->rowCount(index);
+    for (int i = 0; i < rows; i++)
+        setSectioned(model->index(i, 0, index), isSectioned);
+
+    scheduleRender();
+}
+
+bool RenderScene::isSectioned(ModelPart *part) const
+{
+    return sectioned.contains(part);
+}
+
+void RenderScene::setSectionPosition(double fraction)
+{
+    double bounds[6];
+    renderer->ComputeVisiblePropBounds(bounds);
+    if (bounds[0] > bounds[1])
+        return;
+
+    /* Only the origin moves, so the mappers just pick up the new plane equation on their next draw */
+    double x = bounds[0] + (bounds[1] - bounds[0]) * fraction;
+    plane->SetOrigin(x, 0, 0);
+    vrThread->issueCommand(VRRenderThread::SECTION_OFFSET, x);
+
+    scheduleRender();
+}
+
+void RenderScene::sectionPlane(double origin[3], double normal[3]) const
+{
+    plane->GetOrigin(origin);
+    plane->GetNormal(normal);
+}
+
+void RenderScene::syncSection(ModelPart *part)
+{
+    if (part->isFolder())
+        return;
+
+    /* Placeholder boxes are never clipped */
+    bool wanted = sectioned.contains(part) && part->isResident();
+    vtkMapper *mapper = (wanted && part->getActor()) ? part->getActor()->GetMapper() : nullptr;
+
+    vtkSmartPointer<vtkMapper> current = clipped.value(part);
+    if (current != mapper)
+    {
+        if (current)
+            current->RemoveClippingPlane(plane);
+        if (mapper)
+        {
+            mapper->AddClippingPlane(plane);
+            clipped.insert(part, mapper);
+        }
+        else
+            clipped.remove(part);
+    }
+
+    /* The VR thread ignores this until it has been given the actor */
+    if (part->getVRActor())
+        vrThread->setSectioned(part->getVRActor(), wanted);
+}
+
+void RenderScene::handleRowsInserted(const QModelIndex &parent, int first, int last)
+{
+    for (int row = first; row <= last; row++)
+        syncSubtree(model->index(row, 0, parent));
+}
+
+void RenderScene::handleRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last)
+{
+    for (int row = first; row <= last; row++)
+        removeSubtree(static_cast<ModelPart *>(model->index(row, 0, parent).internalPointer()));
+}
+
+void RenderScene::handleDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    if (!topLeft.isValid() || !bottomRight.isValid())
+        return;
+
+    /* Only the rows matter, every column of a part is applied at once */
+    for (int row = topLeft.row(); row <= bottomRight.row(); row++)
+        syncPart(topLeft.sibling(row, 0));
+}
+
+void RenderScene::syncPart(const QModelIndex &index)
+{
+    ModelPart *part = static_cast<ModelPart *>(index.internalPointer());
+    if (!part || part->isFolder())
+        return;
+
+    /* Placeholder boxes are always shown, loaded parts only when they are visible */
+    vtkActor *actor = part->getActor();
+    bool resident = part->isResident();
+    vtkActor *wanted = (actor && (!resident || part->visible())) ? actor : nullptr;
+
+    vtkActor *current = shown.value(part);
+    if (current != wanted)
+    {
+        if (current)
+            renderer->RemoveActor(current);
+
+        if (wanted)
+        {
+            /* Frame the first thing added to an empty scene */
+            if (shown.isEmpty())
+                cameraPending = true;
+
+            renderer->AddActor(wanted);
+            shown.insert(part, wanted);
+        }
+        else
+            shown.remove(part);
+    }
+
+    if (resident && actor)
+    {
+        QColor colour = part->colour();
+        actor->GetProperty()->SetColor(colour.redF(), colour.greenF(), colour.blueF());
+    }
+
+    /* The VR thread gets the actors of loaded, visible parts */
+    vtkActor *wantedVR = (resident && part->visible()) ? part->getVRActor().Get() : nullptr;
+    vtkActor *currentVR = shownInVR.value(part);
+    if (currentVR != wantedVR)
+    {
+        if (currentVR)
+            vrThread->removeActor(currentVR);
+
+        if (wantedVR)
+        {
+            vrThread->addActor(wantedVR, part);
+            shownInVR.insert(part, wantedVR);
+        }
+        else
+            shownInVR.remove(part);
+    }
+
+    if (wantedVR)
+        vrThread->syncActor(part);
+
+    syncSection(part);
+
+    /* Parts that haven't been loaded yet are loaded once made visible */
+    if (!resident && part->visible())
+        emit loadRequested(index);
+
+    scheduleRender();
+}
+
+void RenderScene::syncSubtree(const QModelIndex &index)
+{
+    syncPart(index);
+
+    int rows = model->rowCount(index);
+    for (int i = 0; i < rows; i++)
+        syncSubtree(model->index(i, 0, index));
+}
+
+void RenderScene::removeSubtree(ModelPart *part)
+{
+    if (!part)
+        return;
+
+    for (int i = 0; i < part->childCount(); i++)
+        removeSubtree(part->child(i));
+
+    vtkSmartPointer<vtkActor> actor = shown.take(part);
+    if (actor)
+    {
+        renderer->RemoveActor(actor);
+        scheduleRender();
+    }
+
+    vtkSmartPointer<vtkActor> vrActor = shownInVR.take(part);
+    if (vrActor)
+        vrThread->removeActor(vrActor);
+
+    sectioned.remove(part);
+    vtkSmartPointer<vtkMapper> mapper = clipped.take(part);
+    if (mapper)
+        mapper->RemoveClippingPlane(plane);
+}
+
+void RenderScene::scheduleRender()
+{
+    if (renderPending)
+        return;
+
+    renderPending = true;
+    QTimer::singleShot(0, this, &RenderScene::render);
+}
+
+void RenderScene::render()
+{
+    renderPending = false;
+
+    if (cameraPending)
+    {
+        renderer->ResetCamera();
+        cameraPending = false;
+    }
+    renderer->ResetCameraClippingRange();
+    renderer->Render();
+}
@@ -0,0 +1,170 @@
+/**     @file RenderScene.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief Keeps the renderers in step with the model tree, one change at a time
+ */
+
+#ifndef VIEWER_RENDERSCENE_H
+#define VIEWER_RENDERSCENE_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QModelIndex>
+
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+#include <vtkPlane.h>
+#include <vtkRenderer.h>
+
+class ModelPart;
+class ModelPartList;
+class VRRenderThread;
+
+/**
+ * @class RenderScene
+ * @brief Adds, removes and updates the actors of the parts the model tree reports as changed
+ *
+ * The scene listens to the row and data signals of a ModelPartList, so inserting, deleting or editing
+ * a part only touches that part's actors rather than rebuilding the whole scene. It remembers which actor
+ * of each part is in the desktop renderer and which has been given to the VR thread, so a part whose actor
+ * changes (a placeholder box swapped for the loaded mesh) has the old one taken out.
+ *
+ * Renders are coalesced until control returns to the event loop, and the camera is only reset when
+ * resetCamera() is called or the first part is added to an empty scene.
+ *
+ * Parts can be shown in section: their mappers clip against a plane while drawing, so the mesh isn't
+ * touched and the plane can be moved every frame. The desktop and VR mappers each use their own plane,
+ * kept at the same position.
+ */
+class RenderScene : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructor
+     * @param model The tree whose parts are shown
+     * @param renderer The desktop renderer
+     * @param vrThread The VR thread, given the VR actors of loaded visible parts
+     * @param parent The parent object.
+     */
+    RenderScene(ModelPartList *model, vtkRenderer *renderer, VRRenderThread *vrThread, QObject *parent = nullptr);
+
+    /**
+     * @brief Frame every part in the desktop view
+     */
+    void resetCamera();
+
+    /**
+     * @brief Throw away everything in the scene and add the parts of the whole tree again
+     */
+    void rebuild();
+
+    /**
+     * @brief Show a part and everything below it in section, or take the section off again
+     * @param index The index of the top part
+     * @param sectioned True to clip the parts against the section plane
+     */
+    void setSectioned(const QModelIndex &index, bool sectioned);
+
+    /**
+     * @brief Check if a part is shown in section
+     * @param part The part
+     * @return true if setSectioned() was last called on it (or a folder above it) with true
+     */
+    bool isSectioned(ModelPart *part) const;
+
+    /**
+     * @brief Move the section plane across the scene
+     * @param fraction Where the plane is between the scene's smallest (0) and largest (1) x
+     */
+    void setSectionPosition(double fraction);
+
+    /**
+     * @brief Get the section plane, e.g. to bake it into a part with a clip filter
+     * @param origin Receives a point on the plane
+     * @param normal Receives the plane's normal, the side it points to is kept
+     */
+    void sectionPlane(double origin[3], double normal[3]) const;
+
+signals:
+    /**
+     * @brief A part that hasn't been loaded yet has been made visible
+     * @param index The index of the part
+     */
+    void loadRequested(const QModelIndex &index);
+
+private slots:
+    /**
+     * @brief Adds the actors of new rows (and anything below them)
+     * @param parent The parent of the new rows
+     * @param first The first new row
+     * @param last The last new row
+     */
+    void handleRowsInserted(const QModelIndex &parent, int first, int last);
+
+    /**
+     * @brief Removes the actors of rows (and anything below them) before they are deleted
+     * @param parent The parent of the rows
+     * @param first The first row being removed
+     * @param last The last row being removed
+     */
+    void handleRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+
+    /**
+     * @brief Updates the visibility, colour and actors of edited rows
+     * @param topLeft The first changed index
+     * @param bottomRight The last changed index
+     */
+    void handleDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+
+    /**
+     * @brief Renders the desktop view once the pending changes have been applied
+     */
+    void render();
+
+private:
+    /**
+     * @brief Bring the actors of one part in line with its properties
+     * @param index The index of the part
+     */
+    void syncPart(const QModelIndex &index);
+
+    /**
+     * @brief Sync a part and everything below it
+     * @param index The index of the top part
+     */
+    void syncSubtree(const QModelIndex &index);
+
+    /**
+     * @brief Take the actors of a part and everything below it out of the scene
+     * @param part The top part
+     */
+    void removeSubtree(ModelPart *part);
+
+    /**
+     * @brief Put the section plane on a part's mappers, or take it off, to match isSectioned()
+     * @param part The part
+     */
+    void syncSection(ModelPart *part);
+
+    /**
+     * @brief Ask for a render once control returns to the event loop
+     */
+    void scheduleRender();
+
+    ModelPartList *model;                                    /**< Tree the parts come from */
+    vtkSmartPointer<vtkRenderer> renderer;                   /**< Desktop renderer */
+    VRRenderThread *vrThread;                                /**< Renderer for the headset */
+    QHash<ModelPart *, vtkSmartPointer<vtkActor>> shown;     /**< Actor of each part that is in the desktop renderer */
+    QHash<ModelPart *, vtkSmartPointer<vtkActor>> shownInVR; /**< VR actor of each part given to the VR thread */
+    vtkSmartPointer<vtkPlane> plane;                         /**< Section plane of the desktop mappers */
+    QSet<ModelPart *> sectioned;                             /**< Parts (and folders) shown in section */
+    QHash<ModelPart *, vtkSmartPointer<vtkMapper>> clipped;  /**< Desktop mapper of each part that has the plane */
+    bool renderPending;                                      /**< True while a render is scheduled */
+    bool cameraPending;                                      /**< True if the scheduled render should reset the camera */
+};
+
+#endif
@@ -0,0 +1,173 @@
+/**     @file STLImporter.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ */
+
+#include "STLImporter.h"
+#include "GeometryCache.h"
+
+#include <QThread>
+
+STLImporter::STLImporter(QObject *parent)
+    : QObject(parent), lazy(false), weldTolerance(0.), completed(0), total(0)
+{
+    /* One worker per core, reading is mostly CPU bound once the file is in the page cache */
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+
+    /* Parts loaded on demand parse and weld in parallel themselves, so a couple of workers is plenty */
+    onDemandPool.setMaxThreadCount(2);
+}
+
+STLImporter::~STLImporter()
+{
+    cancel();
+    pool.waitForDone();
+    onDemandPool.waitForDone();
+}
+
+bool STLImporter::importFiles(const QStringList &filePaths)
+{
+    if (isBusy())
+        return false;
+
+    /* Each import gets its own flag so late results from a cancelled import can be recognised */
+    cancelled = std::make_shared<std::atomic_bool>(false);
+    completed = 0;
+    total = filePaths.size();
+
+    if (total == 0)
+    {
+        emit finished(false);
+        return true;
+    }
+
+    std::shared_ptr<std::atomic_bool> batch = cancelled;
+    double tolerance = weldTolerance;
+    for (const QString &filePath : filePaths)
+    {
+        if (lazy)
+        {
+            pool.start([this, filePath, tolerance, batch]()
+                       {
+                if (*batch)
+                    return;
+
+                /* Only the header is read, the geometry is loaded when the part is needed */
+                PartHeader header;
+                bool ok = ModelPart::readSTLHeader(filePath, tolerance, header);
+
+                QMetaObject::invokeMethod(
+                    this, [this, filePath, header, ok, batch]()
+                    { handleHeaderRead(filePath, header, ok, batch); },
+                    Qt::QueuedConnection); });
+            continue;
+        }
+
+        pool.start([this, filePath, tolerance, batch]()
+                   {
+            /* Runs on a worker thread - only read the file here, never touch the tree or renderer */
+            PartMesh mesh = ModelPart::readSTL(filePath, tolerance, batch.get());
+
+            /* Hand the result back to the importer's thread */
+            QMetaObject::invokeMethod(
+                this, [this, filePath, mesh, batch]()
+                { handleFileRead(filePath, mesh, batch); },
+                Qt::QueuedConnection); });
+    }
+
+    return true;
+}
+
+void STLImporter::cancel()
+{
+    if (!isBusy())
+        return;
+
+    /* Drop queued files and tell the running workers to give up */
+    *cancelled = true;
+    pool.clear();
+
+    emit finished(true);
+}
+
+void STLImporter::setWeldTolerance(double tolerance)
+{
+    weldTolerance = tolerance;
+}
+
+void STLImporter::setLazy(bool lazyImport)
+{
+    lazy = lazyImport;
+}
+
+bool STLImporter::isLazy() const
+{
+    return lazy;
+}
+
+void STLImporter::loadPart(const QString &filePath)
+{
+    double tolerance = weldTolerance;
+    onDemandPool.start([this, filePath, tolerance]()
+                       {
+        PartMesh mesh = ModelPart::readSTL(filePath, tolerance);
+
+        QMetaObject::invokeMethod(
+            this, [this, filePath, mesh]()
+            { emit partLoadedOnDemand(filePath, mesh); },
+            Qt::QueuedConnection); });
+}
+
+bool STLImporter::isBusy() const
+{
+    return cancelled && !*cancelled && completed < total;
+}
+
+void STLImporter::handleFileRead(const QString &filePath, const PartMesh &mesh, const std::shared_ptr<std::atomic_bool> &batch)
+{
+    /* Ignore files from an import that has been cancelled, and don't keep their meshes */
+    if (isStale(batch))
+    {
+        GeometryCache::instance().dropUnused(mesh.key);
+        return;
+    }
+
+    if (mesh.polyData != nullptr)
+        emit partLoaded(filePath, mesh);
+    else
+        emit loadFailed(filePath);
+
+    fileProcessed(batch);
+}
+
+void STLImporter::handleHeaderRead(const QString &filePath, const PartHeader &header, bool ok, const std::shared_ptr<std::atomic_bool> &batch)
+{
+    if (isStale(batch))
+        return;
+
+    if (ok)
+        emit headerLoaded(filePath, header);
+    else
+        emit loadFailed(filePath);
+
+    fileProcessed(batch);
+}
+
+bool STLImporter::isStale(const std::shared_ptr<std::atomic_bool> &batch) const
+{
+    return batch != cancelled || *batch;
+}
+
+void STLImporter::fileProcessed(const std::shared_ptr<std::atomic_bool> &batch)
+{
+    /* The receiver may have cancelled the import */
+    if (*batch)
+        return;
+
+    completed++;
+    emit progressChanged(completed, total);
+
+    if (completed == total)
+        emit finished(false);
+}
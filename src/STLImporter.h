@@ -0,0 +1,201 @@
+/**     @file STLImporter.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief This class loads batches of STL files on a pool of worker threads
+ */
+
+#ifndef VIEWER_STLIMPORTER_H
+#define VIEWER_STLIMPORTER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include "ModelPart.h"
+
+#include <atomic>
+#include <memory>
+
+/**
+ * @class STLImporter
+ * @brief Parses STL files on worker threads and hands the finished geometry back to the GUI thread
+ *
+ * Files are read in parallel on a thread pool sized to the machine. Each finished file is delivered
+ * through partLoaded() on the thread that owns the importer (the GUI thread), so the receiver only has
+ * to do the cheap work of adding the part to the tree and attaching its actors.
+ *
+ * In lazy mode an import only reads the triangle count and bounds of each file (headerLoaded()), and
+ * the geometry of a part is loaded later with loadPart() when it is needed.
+ */
+class STLImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructor
+     * @param parent The parent object.
+     */
+    explicit STLImporter(QObject *parent = nullptr);
+
+    /**
+     * @brief Destructor
+     * @brief Cancels any running import and waits for the workers to finish
+     */
+    ~STLImporter();
+
+    /**
+     * @brief Start loading a batch of files in the background
+     * @param filePaths The full paths of the files to load
+     * @return false if an import is already running
+     */
+    bool importFiles(const QStringList &filePaths);
+
+    /**
+     * @brief Cancel the running import
+     * @brief Files that have not started are dropped and files being read are discarded when they finish
+     */
+    void cancel();
+
+    /**
+     * @brief Set the welding tolerance used for the files of the next import
+     * @param tolerance is the distance within which vertices are merged, 0 merges identical vertices only
+     */
+    void setWeldTolerance(double tolerance);
+
+    /**
+     * @brief Choose whether imports read whole files or only their headers
+     * @param lazy If true the next import emits headerLoaded() instead of partLoaded()
+     */
+    void setLazy(bool lazy);
+
+    /**
+     * @brief Check if imports only read the files' headers
+     * @return true in lazy mode
+     */
+    bool isLazy() const;
+
+    /**
+     * @brief Load the geometry of a single file in the background, independently of any import
+     * @param filePath The full path of the file
+     * @note The result is delivered through partLoadedOnDemand()
+     */
+    void loadPart(const QString &filePath);
+
+    /**
+     * @brief Check if an import is running
+     * @return true if an import is running
+     */
+    bool isBusy() const;
+
+signals:
+    /**
+     * @brief Emitted on the importer's thread each time a file has been loaded
+     * @param filePath The path of the file
+     * @param mesh The mesh read from the file
+     */
+    void partLoaded(const QString &filePath, const PartMesh &mesh);
+
+    /**
+     * @brief Emitted on the importer's thread each time a file's header has been read in lazy mode
+     * @param filePath The path of the file
+     * @param header The triangle count and bounds of the file
+     */
+    void headerLoaded(const QString &filePath, const PartHeader &header);
+
+    /**
+     * @brief Emitted on the importer's thread when a file requested with loadPart() has been read
+     * @param filePath The path of the file
+     * @param mesh The mesh read from the file (with a null polydata on failure)
+     */
+    void partLoadedOnDemand(const QString &filePath, const PartMesh &mesh);
+
+    /**
+     * @brief Emitted when a file could not be read
+     * @param filePath The path of the file
+     */
+    void loadFailed(const QString &filePath);
+
+    /**
+     * @brief Emitted each time a file has been processed
+     * @param completed The number of files processed so far
+     * @param total The number of files in the import
+     */
+    void progressChanged(int completed, int total);
+
+    /**
+     * @brief Emitted once all files have been processed or the import was cancelled
+     * @param cancelled True if the import was cancelled
+     */
+    void finished(bool cancelled);
+
+private:
+    /**
+     * @brief Called on the importer's thread when a worker has finished a file
+     * @param filePath The path of the file
+     * @param mesh The mesh read from the file (with a null polydata on failure)
+     * @param batch The cancel flag of the import the file belongs to
+     */
+    void handleFileRead(const QString &filePath, const PartMesh &mesh, const std::shared_ptr<std::atomic_bool> &batch);
+
+    /**
+     * @brief Called on the importer's thread when a worker has read a file's header in lazy mode
+     * @param filePath The path of the file
+     * @param header The header read from the file
+     * @param ok False if the file could not be opened
+     * @param batch The cancel flag of the import the file belongs to
+     */
+    void handleHeaderRead(const QString &filePath, const PartHeader &header, bool ok, const std::shared_ptr<std::atomic_bool> &batch);
+
+    /**
+     * @brief Check if a result belongs to an import that has been cancelled or replaced
+     * @param batch The cancel flag of the import the result belongs to
+     * @return true if the result should be thrown away
+     */
+    bool isStale(const std::shared_ptr<std::atomic_bool> &batch) const;
+
+    /**
+     * @brief Count a file as processed and report progress
+     * @param batch The cancel flag of the import the file belongs to
+     */
+    void fileProcessed(const std::shared_ptr<std::atomic_bool> &batch);
+
+    /**
+     * @brief The worker threads
+     */
+    QThreadPool pool;
+
+    /**
+     * @brief Worker threads for loadPart(), kept apart so cancelling an import doesn't drop them
+     */
+    QThreadPool onDemandPool;
+
+    /**
+     * @brief True if imports only read the files' headers
+     */
+    bool lazy;
+
+    /**
+     * @brief Cancel flag of the running import, shared with its workers
+     */
+    std::shared_ptr<std::atomic_bool> cancelled;
+
+    /**
+     * @brief Welding tolerance for new imports
+     */
+    double weldTolerance;
+
+    /**
+     * @brief Number of files processed in the running import
+     */
+    int completed;
+
+    /**
+     * @brief Number of files in the running import
+     */
+    int total;
+};
+
+#endif
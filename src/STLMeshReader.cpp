@@ -0,0 +1,476 @@
+/**     @file STLMeshReader.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ */
+
+#include "STLMeshReader.h"
+
+#include <QtEndian>
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkPoints.h>
+#include <vtkTypeInt32Array.h>
+#include <vtkIdTypeArray.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+    /* Binary STL layout: 80 byte header, 32 bit triangle count, then one 50 byte record per triangle
+     * holding the normal (3 floats), three vertices (9 floats) and a 16 bit attribute count
+     */
+    const qint64 headerSize = 84;
+    const qint64 recordSize = 50;
+    const qint64 vertexOffset = 12;
+
+    /* How many triangles to read between checks of the cancel flag */
+    const vtkIdType cancelCheckInterval = 1 << 16;
+
+    /* Read a little endian float from an unaligned position in the file */
+    inline float readFloat(const uchar *p)
+    {
+        return qFromLittleEndian<float>(p);
+    }
+
+    /* ASCII files are parsed in chunks of roughly this many bytes */
+    const qint64 asciiChunkSize = 1 << 22;
+
+    inline bool isSpace(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\v';
+    }
+
+    /* Compare a token with a lower case keyword, ignoring the case of the token */
+    inline bool isKeyword(const char *token, std::size_t length, const char *keyword)
+    {
+        std::size_t i = 0;
+        for (; i < length && keyword[i]; i++)
+        {
+            char c = token[i];
+            if (c >= 'A' && c <= 'Z')
+                c = char(c - 'A' + 'a');
+            if (c != keyword[i])
+                return false;
+        }
+        return i == length && keyword[i] == 0;
+    }
+
+    /* Find the first position after the next "endfacet" line at or after from, or end if there is none */
+    const char *nextFacetBoundary(const char *from, const char *end)
+    {
+        static const char keyword[] = "endfacet";
+        const std::size_t length = sizeof(keyword) - 1;
+
+        auto sameLetter = [](char c, char k)
+        { return c == k || c == char(k - 'a' + 'A'); };
+
+        const char *p = std::search(from, end, keyword, keyword + length, sameLetter);
+        if (p == end)
+            return end;
+
+        p = std::find(p + length, end, '\n');
+        return p == end ? end : p + 1;
+    }
+
+    /* Parse a float, allowing a leading '+' which std::from_chars doesn't accept */
+    inline bool parseFloat(const char *&p, const char *end, float &value)
+    {
+        if (p != end && *p == '+')
+            p++;
+
+        std::from_chars_result result = std::from_chars(p, end, value);
+        if (result.ec != std::errc() || (result.ptr != end && !isSpace(*result.ptr)))
+            return false;
+
+        p = result.ptr;
+        return true;
+    }
+
+    /* Parse the facets in [p, end), which must start and end on a facet boundary. Only the
+     * vertex coordinates are kept, the normals are recomputed from the vertices anyway.
+     */
+    bool parseAsciiChunk(const char *p, const char *end, std::vector<float> &coords)
+    {
+        /* Vertices seen in the current facet, -1 outside a facet */
+        int vertices = -1;
+
+        while (true)
+        {
+            while (p != end && isSpace(*p))
+                p++;
+            if (p == end)
+                break;
+
+            const char *token = p;
+            while (p != end && !isSpace(*p))
+                p++;
+            std::size_t length = std::size_t(p - token);
+
+            if (isKeyword(token, length, "vertex"))
+            {
+                if (vertices < 0 || vertices == 3)
+                    return false;
+
+                for (int k = 0; k < 3; k++)
+                {
+                    while (p != end && isSpace(*p))
+                        p++;
+                    float value;
+                    if (!parseFloat(p, end, value))
+                        return false;
+                    coords.push_back(value);
+                }
+                vertices++;
+            }
+            else if (isKeyword(token, length, "facet"))
+            {
+                if (vertices >= 0)
+                    return false;
+                vertices = 0;
+            }
+            else if (isKeyword(token, length, "endfacet"))
+            {
+                if (vertices != 3)
+                    return false;
+                vertices = -1;
+            }
+            else if (isKeyword(token, length, "solid") || isKeyword(token, length, "endsolid"))
+            {
+                /* The rest of the line is the solid's name, which could be anything */
+                p = std::find(p, end, '\n');
+            }
+
+            /* Everything else ("normal" and its values, "outer", "loop", "endloop") is skipped */
+        }
+
+        return vertices < 0;
+    }
+}
+
+STLMeshReader::STLMeshReader(const QString &fileName)
+    : file(fileName), mapping(nullptr), mappingSize(0), triangles(0), binary(false)
+{
+}
+
+STLMeshReader::~STLMeshReader()
+{
+    if (mapping)
+        file.unmap(const_cast<uchar *>(mapping));
+}
+
+bool STLMeshReader::open()
+{
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        error = file.errorString();
+        return false;
+    }
+
+    mappingSize = file.size();
+    if (mappingSize == 0)
+    {
+        error = QString("File is empty");
+        return false;
+    }
+
+    mapping = file.map(0, mappingSize);
+    if (!mapping)
+    {
+        error = file.errorString();
+        return false;
+    }
+
+    if (mappingSize < headerSize)
+    {
+        /* Too small to hold a binary header, can only be a (tiny) ASCII file */
+        binary = false;
+        return true;
+    }
+
+    quint32 count = qFromLittleEndian<quint32>(mapping + 80);
+
+    /* The size check is more reliable than the "solid" keyword, which some exporters also
+     * write at the start of binary files. Allow trailing bytes unless it looks like ASCII.
+     */
+    qint64 expected = headerSize + recordSize * qint64(count);
+    bool startsWithSolid = std::memcmp(mapping, "solid", 5) == 0;
+    binary = (expected == mappingSize) || (count > 0 && expected < mappingSize && !startsWithSolid);
+    triangles = binary ? vtkIdType(count) : 0;
+
+    return true;
+}
+
+bool STLMeshReader::isBinary() const
+{
+    return binary;
+}
+
+vtkIdType STLMeshReader::triangleCount() const
+{
+    return triangles;
+}
+
+quint64 STLMeshReader::contentHash() const
+{
+    if (!mapping)
+        return 0;
+
+    return hashBytes(mapping, mappingSize);
+}
+
+quint64 STLMeshReader::hashBytes(const uchar *data, qint64 size)
+{
+    /* XXH64 with a seed of 0 */
+    const quint64 p1 = 11400714785074694791ULL;
+    const quint64 p2 = 14029467366897019727ULL;
+    const quint64 p3 = 1609587929392839161ULL;
+    const quint64 p4 = 9650029242287828579ULL;
+    const quint64 p5 = 2870177450012600261ULL;
+
+    auto rotl = [](quint64 x, int r)
+    { return (x << r) | (x >> (64 - r)); };
+    auto round = [&](quint64 acc, quint64 input)
+    { return rotl(acc + input * p2, 31) * p1; };
+    auto merge = [&](quint64 acc, quint64 v)
+    { return (acc ^ round(0, v)) * p1 + p4; };
+
+    const uchar *p = data;
+    const uchar *end = data + size;
+    quint64 h;
+
+    if (size >= 32)
+    {
+        quint64 v1 = p1 + p2, v2 = p2, v3 = 0, v4 = 0 - p1;
+        const uchar *limit = end - 32;
+        do
+        {
+            v1 = round(v1, qFromLittleEndian<quint64>(p));
+            v2 = round(v2, qFromLittleEndian<quint64>(p + 8));
+            v3 = round(v3, qFromLittleEndian<quint64>(p + 16));
+            v4 = round(v4, qFromLittleEndian<quint64>(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge(h, v1);
+        h = merge(h, v2);
+        h = merge(h, v3);
+        h = merge(h, v4);
+    }
+    else
+    {
+        h = p5;
+    }
+
+    h += quint64(size);
+
+    for (; p + 8 <= end; p += 8)
+        h = rotl(h ^ round(0, qFromLittleEndian<quint64>(p)), 27) * p1 + p4;
+    if (p + 4 <= end)
+    {
+        h = rotl(h ^ (quint64(qFromLittleEndian<quint32>(p)) * p1), 23) * p2 + p3;
+        p += 4;
+    }
+    for (; p < end; p++)
+        h = rotl(h ^ (quint64(*p) * p5), 11) * p1;
+
+    h ^= h >> 33;
+    h *= p2;
+    h ^= h >> 29;
+    h *= p3;
+    h ^= h >> 32;
+    return h;
+}
+
+qint64 STLMeshReader::fileSize() const
+{
+    return mappingSize;
+}
+
+bool STLMeshReader::computeBounds(double bounds[6]) const
+{
+    if (!binary || !mapping || triangles == 0)
+        return false;
+
+    float lo[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    float hi[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+
+    const uchar *record = mapping + headerSize;
+    for (vtkIdType i = 0; i < triangles; i++, record += recordSize)
+    {
+        const uchar *v = record + vertexOffset;
+        for (int j = 0; j < 9; j++)
+        {
+            float x = readFloat(v + 4 * j);
+            lo[j % 3] = std::min(lo[j % 3], x);
+            hi[j % 3] = std::max(hi[j % 3], x);
+        }
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+        bounds[2 * k] = lo[k];
+        bounds[2 * k + 1] = hi[k];
+    }
+    return true;
+}
+
+vtkSmartPointer<vtkFloatArray> STLMeshReader::readVertices(const std::atomic_bool *cancelled)
+{
+    if (!mapping)
+    {
+        error = QString("File is not open");
+        return nullptr;
+    }
+
+    if (!binary)
+        return readAsciiVertices(cancelled);
+
+    /* Copy the vertices of each record straight into the final point array */
+    vtkSmartPointer<vtkFloatArray> coords = vtkSmartPointer<vtkFloatArray>::New();
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(3 * triangles);
+    float *out = coords->GetPointer(0);
+
+    const uchar *record = mapping + headerSize;
+    for (vtkIdType i = 0; i < triangles; i++, record += recordSize, out += 9)
+    {
+        if (cancelled && (i % cancelCheckInterval) == 0 && *cancelled)
+            return nullptr;
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        std::memcpy(out, record + vertexOffset, 9 * sizeof(float));
+#else
+        for (int j = 0; j < 9; j++)
+            out[j] = readFloat(record + vertexOffset + 4 * j);
+#endif
+    }
+
+    /* The file isn't needed any more */
+    file.unmap(const_cast<uchar *>(mapping));
+    mapping = nullptr;
+
+    return coords;
+}
+
+vtkSmartPointer<vtkFloatArray> STLMeshReader::readAsciiVertices(const std::atomic_bool *cancelled)
+{
+    const char *begin = reinterpret_cast<const char *>(mapping);
+    const char *end = begin + mappingSize;
+
+    /* 1. Split the file into chunks that each end just after an "endfacet" line */
+    std::vector<const char *> bounds;
+    bounds.push_back(begin);
+    while (bounds.back() != end)
+    {
+        const char *from = bounds.back() + std::min<qint64>(asciiChunkSize, end - bounds.back());
+        bounds.push_back(nextFacetBoundary(from, end));
+    }
+
+    /* 2. Parse the chunks in parallel, each into its own buffer */
+    const vtkIdType chunkCount = vtkIdType(bounds.size()) - 1;
+    std::vector<std::vector<float>> chunks(chunkCount);
+    std::atomic_bool failed(false);
+
+    auto parseChunks = [&](vtkIdType first, vtkIdType last)
+    {
+        for (vtkIdType c = first; c < last; c++)
+        {
+            if (failed || (cancelled && *cancelled))
+                return;
+
+            /* A little over one vertex per 60 bytes is typical */
+            chunks[c].reserve(std::size_t(bounds[c + 1] - bounds[c]) / 20);
+            if (!parseAsciiChunk(bounds[c], bounds[c + 1], chunks[c]))
+                failed = true;
+        }
+    };
+    vtkSMPTools::For(0, chunkCount, 1, parseChunks);
+
+    if (cancelled && *cancelled)
+        return nullptr;
+
+    if (failed)
+    {
+        error = QString("Syntax error in ASCII STL file");
+        return nullptr;
+    }
+
+    /* 3. Join the chunks in file order */
+    std::vector<vtkIdType> offsets(chunkCount + 1, 0);
+    for (vtkIdType c = 0; c < chunkCount; c++)
+        offsets[c + 1] = offsets[c] + vtkIdType(chunks[c].size());
+
+    vtkSmartPointer<vtkFloatArray> coords = vtkSmartPointer<vtkFloatArray>::New();
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(offsets[chunkCount] / 3);
+    float *out = coords->GetPointer(0);
+
+    auto joinChunks = [&](vtkIdType first, vtkIdType last)
+    {
+        for (vtkIdType c = first; c < last; c++)
+        {
+            std::copy(chunks[c].begin(), chunks[c].end(), out + offsets[c]);
+            std::vector<float>().swap(chunks[c]);
+        }
+    };
+    vtkSMPTools::For(0, chunkCount, 1, joinChunks);
+
+    triangles = coords->GetNumberOfTuples() / 3;
+
+    /* The file isn't needed any more */
+    file.unmap(const_cast<uchar *>(mapping));
+    mapping = nullptr;
+
+    return coords;
+}
+
+vtkSmartPointer<vtkPolyData> STLMeshReader::read(const std::atomic_bool *cancelled)
+{
+    /* 1. Read the vertices */
+    vtkSmartPointer<vtkFloatArray> coords = readVertices(cancelled);
+    if (coords == nullptr)
+        return nullptr;
+
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetData(coords);
+
+    /* 2. Every triangle uses its own three vertices, so the connectivity is just 0, 1, 2, ...
+     * Use 32 bit ids where they fit to halve the size of the cell array
+     */
+    vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+    vtkIdType vertexCount = coords->GetNumberOfTuples();
+    if (vertexCount <= std::numeric_limits<vtkTypeInt32>::max())
+    {
+        vtkSmartPointer<vtkTypeInt32Array> connectivity = vtkSmartPointer<vtkTypeInt32Array>::New();
+        connectivity->SetNumberOfValues(vertexCount);
+        std::iota(connectivity->GetPointer(0), connectivity->GetPointer(0) + vertexCount, vtkTypeInt32(0));
+        cells->SetData(3, connectivity);
+    }
+    else
+    {
+        vtkSmartPointer<vtkIdTypeArray> connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+        connectivity->SetNumberOfValues(vertexCount);
+        std::iota(connectivity->GetPointer(0), connectivity->GetPointer(0) + vertexCount, vtkIdType(0));
+        cells->SetData(3, connectivity);
+    }
+
+    vtkSmartPointer<vtkPolyData> data = vtkSmartPointer<vtkPolyData>::New();
+    data->SetPoints(points);
+    data->SetPolys(cells);
+
+    return data;
+}
+
+QString STLMeshReader::errorString() const
+{
+    return error;
+}
@@ -0,0 +1,135 @@
+/**     @file STLMeshReader.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief This class reads binary and ASCII STL files straight from a memory mapping
+ */
+
+#ifndef VIEWER_STLMESHREADER_H
+#define VIEWER_STLMESHREADER_H
+
+#include <QFile>
+#include <QString>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+#include <vtkFloatArray.h>
+
+#include <atomic>
+
+/**
+ * @class STLMeshReader
+ * @brief Reads STL files from a memory mapping without going through vtkSTLReader
+ *
+ * The file is mapped rather than read, and whether it is binary or ASCII is decided from its
+ * contents rather than its extension. For binary files the triangle count is available as soon as
+ * the file is opened and the bounds can be found with a sweep over the mapping that doesn't allocate
+ * anything. read() copies the vertices of each 50 byte triangle record straight into the point array
+ * of the output, so the only copy made is the one into the final vtkFloatArray.
+ *
+ * ASCII files are split into chunks that end after an "endfacet" line, and the chunks are parsed in
+ * parallel with std::from_chars, which rounds exactly like the serial reader. The chunks are then
+ * joined in file order, so the result doesn't depend on how the file was split.
+ */
+class STLMeshReader
+{
+public:
+    /**
+     * @brief Constructor
+     * @param fileName The file to read
+     */
+    explicit STLMeshReader(const QString &fileName);
+
+    /**
+     * @brief Destructor
+     * @brief Unmaps the file
+     */
+    ~STLMeshReader();
+
+    /**
+     * @brief Map the file and read its header
+     * @return false if the file could not be opened or mapped
+     */
+    bool open();
+
+    /**
+     * @brief Check if the file is a binary STL
+     * @return true if the file size matches the triangle count in the header
+     * @note Only valid after open()
+     */
+    bool isBinary() const;
+
+    /**
+     * @brief Get the number of triangles in the file
+     * @return triangle count from the header (0 for ASCII files until they have been read)
+     * @note Only valid after open()
+     */
+    vtkIdType triangleCount() const;
+
+    /**
+     * @brief Hash the whole file, so files with identical content can share a mesh
+     * @return 64 bit XXH64 hash of the file, 0 if the file isn't open
+     * @note Must be called before readVertices() or read(), which release the mapping
+     */
+    quint64 contentHash() const;
+
+    /**
+     * @brief Hash a block of memory with the same function as contentHash()
+     * @param data Start of the block
+     * @param size Size of the block in bytes
+     * @return 64 bit XXH64 hash
+     */
+    static quint64 hashBytes(const uchar *data, qint64 size);
+
+    /**
+     * @brief Get the size of the file
+     * @return size in bytes
+     * @note Only valid after open()
+     */
+    qint64 fileSize() const;
+
+    /**
+     * @brief Find the bounds of the mesh without building it
+     * @param bounds Receives xmin, xmax, ymin, ymax, zmin, zmax
+     * @return false if the file isn't an open binary STL or has no triangles
+     */
+    bool computeBounds(double bounds[6]) const;
+
+    /**
+     * @brief Read the vertices of every triangle, without building any cells
+     * @param cancelled is polled while reading, reading stops once it is set (may be null)
+     * @return 3 vertices per triangle in file order, or nullptr if the file isn't open, an ASCII file
+     *         couldn't be parsed or reading was cancelled
+     */
+    vtkSmartPointer<vtkFloatArray> readVertices(const std::atomic_bool *cancelled = nullptr);
+
+    /**
+     * @brief Build the mesh as one triangle per record, vertices are not merged
+     * @param cancelled is polled while reading, reading stops once it is set (may be null)
+     * @return the mesh, or nullptr if the file couldn't be read or reading was cancelled
+     */
+    vtkSmartPointer<vtkPolyData> read(const std::atomic_bool *cancelled = nullptr);
+
+    /**
+     * @brief Get a description of the last error
+     * @return error message
+     */
+    QString errorString() const;
+
+private:
+    /**
+     * @brief Read the vertices of an ASCII file, parsing chunks of it in parallel
+     * @param cancelled is checked before each chunk is parsed (may be null)
+     * @return 3 vertices per facet in file order, or nullptr on a syntax error or if cancelled
+     */
+    vtkSmartPointer<vtkFloatArray> readAsciiVertices(const std::atomic_bool *cancelled);
+
+    QFile file;                  /**< The file being read */
+    const uchar *mapping;        /**< Start of the mapped file */
+    qint64 mappingSize;          /**< Size of the mapped file in bytes */
+    vtkIdType triangles;         /**< Triangle count of a binary file */
+    bool binary;                 /**< True if the file is a binary STL */
+    QString error;               /**< Last error */
+};
+
+#endif
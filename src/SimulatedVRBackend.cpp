@@ -0,0 +1,119 @@
+/**     @file SimulatedVRBackend.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ */
+
+#include "SimulatedVRBackend.h"
+
+#include <vtkMath.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    /* Circle the scene once every 20 s at a distance that keeps it all in view, bobbing gently like a
+     * head that isn't perfectly still
+     */
+    HeadPose orbit(double seconds, const double bounds[6])
+    {
+        HeadPose pose;
+        double centre[3];
+        double size = 0.;
+        for (int i = 0; i < 3; i++)
+        {
+            centre[i] = (bounds[2 * i] + bounds[2 * i + 1]) / 2.;
+            size = std::max(size, bounds[2 * i + 1] - bounds[2 * i]);
+        }
+        if (size <= 0.)
+            size = 1.;
+
+        double angle = seconds * 2. * vtkMath::Pi() / 20.;
+        pose.position[0] = centre[0] + 1.5 * size * std::sin(angle);
+        pose.position[1] = centre[1] + 0.3 * size + 0.01 * size * std::sin(seconds * 7.);
+        pose.position[2] = centre[2] + 1.5 * size * std::cos(angle);
+        for (int i = 0; i < 3; i++)
+            pose.focalPoint[i] = centre[i];
+        return pose;
+    }
+}
+
+SimulatedVRBackend::SimulatedVRBackend(int width, int height)
+    : eyeWidth(width), eyeHeight(height), script(orbit), frameLimit(0), frameCount(0)
+{
+}
+
+void SimulatedVRBackend::setPoseScript(const PoseScript &poseScript)
+{
+    script = poseScript;
+}
+
+void SimulatedVRBackend::setFrameLimit(long frames)
+{
+    frameLimit = frames;
+}
+
+bool SimulatedVRBackend::initialise()
+{
+    simRenderer = vtkSmartPointer<vtkRenderer>::New();
+
+    /* Both eyes go into one offscreen window, side by side as on the headset's panel */
+    window = vtkSmartPointer<vtkRenderWindow>::New();
+    window->SetOffScreenRendering(1);
+    window->SetSize(2 * eyeWidth, eyeHeight);
+    window->SetStereoTypeToSplitViewportHorizontal();
+    window->StereoRenderOn();
+    window->AddRenderer(simRenderer);
+
+    /* Roughly the separation of a pair of eyes seen from a metre away */
+    simRenderer->GetActiveCamera()->SetEyeAngle(3.5);
+    simRenderer->GetActiveCamera()->SetViewAngle(100.);
+
+    frameCount = 0;
+    started = std::chrono::steady_clock::now();
+    return true;
+}
+
+vtkRenderer *SimulatedVRBackend::renderer()
+{
+    return simRenderer;
+}
+
+void SimulatedVRBackend::doOneFrame()
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    double bounds[6];
+    simRenderer->ComputeVisiblePropBounds(bounds);
+    if (bounds[0] > bounds[1])
+    {
+        for (int i = 0; i < 6; i++)
+            bounds[i] = (i % 2) ? 1. : -1.;
+    }
+
+    HeadPose pose = script(seconds, bounds);
+    vtkCamera *camera = simRenderer->GetActiveCamera();
+    camera->SetPosition(pose.position);
+    camera->SetFocalPoint(pose.focalPoint);
+    camera->SetViewUp(pose.viewUp);
+    simRenderer->ResetCameraClippingRange();
+
+    window->Render();
+    frameCount++;
+}
+
+bool SimulatedVRBackend::isDone()
+{
+    return frameLimit > 0 && frameCount >= frameLimit;
+}
+
+void SimulatedVRBackend::finalise()
+{
+    window->Finalize();
+}
+
+QString SimulatedVRBackend::error() const
+{
+    return QString();
+}
@@ -0,0 +1,81 @@
+/**     @file SimulatedVRBackend.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief Stand-in for a headset that renders offscreen from a scripted head pose
+ */
+
+#ifndef VIEWER_SIMULATEDVRBACKEND_H
+#define VIEWER_SIMULATEDVRBACKEND_H
+
+#include "VRBackend.h"
+
+#include <vtkSmartPointer.h>
+#include <vtkRenderWindow.h>
+#include <vtkCamera.h>
+
+#include <chrono>
+#include <functional>
+
+/**
+ * @brief Where the simulated head is and what it looks at
+ */
+struct HeadPose
+{
+  double position[3] = {0., 0., 1.}; /**< Eye centre */
+  double focalPoint[3] = {0., 0., 0.}; /**< Point looked at */
+  double viewUp[3] = {0., 1., 0.};   /**< Up direction of the head */
+};
+
+/**
+ * @class SimulatedVRBackend
+ * @brief Renders both eyes side by side to an offscreen window, so the VR loop runs without a headset
+ *
+ * It goes through the same render thread, command queue and actor management as a real headset, so they
+ * can be timed and tested on machines with no HMD (including headless ones using the OSMesa/EGL builds of
+ * VTK). The head follows a script, by default a slow orbit around the scene.
+ */
+class SimulatedVRBackend : public VRBackend
+{
+public:
+  /** @brief Gives the head pose at a time since the backend started, in seconds, and the scene's bounds */
+  typedef std::function<HeadPose(double seconds, const double bounds[6])> PoseScript;
+
+  /**
+   * @brief Constructor
+   * @param width Width of each eye's image in pixels
+   * @param height Height of each eye's image in pixels
+   */
+  SimulatedVRBackend(int width = 1080, int height = 1200);
+
+  /**
+   * @brief Replace the head's motion (call before VR starts)
+   * @param script The pose script
+   */
+  void setPoseScript(const PoseScript &script);
+
+  /**
+   * @brief Stop after a number of frames, for benchmarks
+   * @param frames Number of frames to draw, 0 to run until VR is stopped
+   */
+  void setFrameLimit(long frames);
+
+  bool initialise() override;
+  vtkRenderer *renderer() override;
+  void doOneFrame() override;
+  bool isDone() override;
+  void finalise() override;
+  QString error() const override;
+
+private:
+  int eyeWidth;                                         /**< Width of each eye's image */
+  int eyeHeight;                                        /**< Height of each eye's image */
+  PoseScript script;                                    /**< Gives the head pose over time */
+  long frameLimit;                                      /**< Frames to draw, 0 for no limit */
+  long frameCount;                                      /**< Frames drawn so far */
+  std::chrono::steady_clock::time_point started;        /**< When initialise() was called */
+  vtkSmartPointer<vtkRenderer> simRenderer;             /**< Renderer the scene is added to */
+  vtkSmartPointer<vtkRenderWindow> window;              /**< Offscreen stereo window */
+};
+
+#endif
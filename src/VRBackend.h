@@ -0,0 +1,71 @@
+/**     @file VRBackend.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief What the VR render thread draws to
+ */
+
+#ifndef VIEWER_VRBACKEND_H
+#define VIEWER_VRBACKEND_H
+
+#include <QString>
+
+#include <vtkRenderer.h>
+
+/**
+ * @class VRBackend
+ * @brief The headset (or a stand-in for it) the VR render thread draws to
+ *
+ * The render thread owns the scene and its command loop, a backend owns the window, camera and
+ * interactor that turn the scene into frames. Everything here is called on the render thread.
+ */
+class VRBackend
+{
+public:
+  /**
+   * @brief Destructor
+   */
+  virtual ~VRBackend() = default;
+
+  /**
+   * @brief Create the renderer, window and camera
+   * @return false if the backend can't run, see error()
+   */
+  virtual bool initialise() = 0;
+
+  /**
+   * @brief Get the renderer the scene is added to
+   * @return the renderer, valid after initialise() succeeded
+   */
+  virtual vtkRenderer *renderer() = 0;
+
+  /**
+   * @brief Process pending events and draw one frame
+   */
+  virtual void doOneFrame() = 0;
+
+  /**
+   * @brief Get how often the backend shows a frame, used as the frame budget
+   * @return frames per second, 90 unless the backend knows better
+   */
+  virtual double refreshRate() const { return 90.; }
+
+  /**
+   * @brief Check if the backend wants to stop (e.g. the headset was closed)
+   * @return true once the loop should end
+   */
+  virtual bool isDone() = 0;
+
+  /**
+   * @brief Close the window, the renderer can't be used afterwards
+   */
+  virtual void finalise() = 0;
+
+  /**
+   * @brief Get why initialise() failed
+   * @return a message for the user
+   */
+  virtual QString error() const = 0;
+};
+
+#endif
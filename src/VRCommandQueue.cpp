@@ -0,0 +1,42 @@
+/**     @file VRCommandQueue.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ */
+
+#include "VRCommandQueue.h"
+
+#include <chrono>
+
+VRCommandQueue::VRCommandQueue() : head(0), tail(0)
+{
+}
+
+bool VRCommandQueue::push(const VRCommand &command)
+{
+    quint32 t = tail.load(std::memory_order_relaxed);
+
+    /* The indices only ever increase (wrapping at 2^32), so the difference is the number queued */
+    if (t - head.load(std::memory_order_acquire) >= capacity)
+        return false;
+
+    slots[t & (capacity - 1)] = command;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+bool VRCommandQueue::pop(VRCommand &command)
+{
+    quint32 h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+        return false;
+
+    command = slots[h & (capacity - 1)];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+qint64 VRCommandQueue::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
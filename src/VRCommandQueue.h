@@ -0,0 +1,72 @@
+/**     @file VRCommandQueue.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief Lock-free queue carrying commands from the GUI thread to the VR thread
+ */
+
+#ifndef VIEWER_VRCOMMANDQUEUE_H
+#define VIEWER_VRCOMMANDQUEUE_H
+
+#include <QtGlobal>
+
+#include <array>
+#include <atomic>
+
+/**
+ * @brief One command for the VR thread, with everything it needs to be applied
+ */
+struct VRCommand
+{
+  int type = 0;       /**< One of the VRRenderThread command values */
+  double value = 0.;  /**< Angle for the rotation commands */
+  qint64 issued = 0;  /**< Steady clock time the command was issued, in nanoseconds */
+};
+
+/**
+ * @class VRCommandQueue
+ * @brief Bounded single-producer/single-consumer ring buffer of VRCommands
+ *
+ * Only the GUI thread may push() and only the VR thread may pop(). Neither side ever blocks or takes a
+ * lock: the producer owns the tail index, the consumer owns the head index, and each publishes its index
+ * with release ordering after touching the slot, so a command is never seen half written.
+ */
+class VRCommandQueue
+{
+public:
+  /** Number of commands the queue can hold, a power of two */
+  static const quint32 capacity = 1024;
+
+  /**
+   * @brief Constructor
+   */
+  VRCommandQueue();
+
+  /**
+   * @brief Add a command (producer thread only)
+   * @param command The command to add
+   * @return false if the queue is full and the command was dropped
+   */
+  bool push(const VRCommand &command);
+
+  /**
+   * @brief Take the oldest command (consumer thread only)
+   * @param command Receives the command
+   * @return false if the queue is empty
+   */
+  bool pop(VRCommand &command);
+
+  /**
+   * @brief Get the steady clock time now, in the units of VRCommand::issued
+   * @return time in nanoseconds
+   */
+  static qint64 now();
+
+private:
+  std::array<VRCommand, capacity> slots; /**< The ring */
+
+  alignas(64) std::atomic<quint32> head; /**< Next slot to pop, written by the consumer */
+  alignas(64) std::atomic<quint32> tail; /**< Next slot to push, written by the producer */
+};
+
+#endif
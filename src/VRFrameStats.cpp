@@ -0,0 +1,112 @@
+/**     @file VRFrameStats.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ */
+
+#include "VRFrameStats.h"
+
+#include <QFile>
+#include <QTextStream>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    double toMilliseconds(qint64 nanoseconds)
+    {
+        return nanoseconds / 1e6;
+    }
+
+    /* The value below which a fraction of the values lie, the values are reordered */
+    qint64 percentile(std::vector<qint64> &values, double fraction)
+    {
+        std::size_t n = std::size_t(fraction * (values.size() - 1) + 0.5);
+        std::nth_element(values.begin(), values.begin() + n, values.end());
+        return values[n];
+    }
+}
+
+VRFrameStats::VRFrameStats() : written(0), frameBudget(0), missed(0), missedTotal(0)
+{
+}
+
+void VRFrameStats::reset(qint64 budget)
+{
+    QMutexLocker locker(&mutex);
+    written = 0;
+    frameBudget = budget;
+    missed = 0;
+    missedTotal = 0;
+}
+
+void VRFrameStats::record(const VRFrameSample &sample)
+{
+    QMutexLocker locker(&mutex);
+    samples[written % capacity] = sample;
+    written++;
+
+    /* A frame counts as missed once it runs half a frame over, i.e. the headset had to show a frame twice */
+    if (frameBudget > 0 && sample.interval > frameBudget + frameBudget / 2)
+    {
+        missed++;
+        missedTotal++;
+    }
+}
+
+VRFrameSummary VRFrameStats::summarise()
+{
+    VRFrameSummary summary;
+    std::vector<qint64> intervals;
+
+    {
+        QMutexLocker locker(&mutex);
+        int count = int(std::min<qint64>(written, capacity));
+        intervals.reserve(count);
+        for (int i = 0; i < count; i++)
+            intervals.push_back(samples[i].interval);
+
+        summary.budget = toMilliseconds(frameBudget);
+        summary.missed = missed;
+        summary.missedTotal = missedTotal;
+        missed = 0;
+    }
+
+    summary.frames = int(intervals.size());
+    if (intervals.empty())
+        return summary;
+
+    summary.p50 = toMilliseconds(percentile(intervals, 0.50));
+    summary.p95 = toMilliseconds(percentile(intervals, 0.95));
+    summary.p99 = toMilliseconds(percentile(intervals, 0.99));
+    return summary;
+}
+
+bool VRFrameStats::dump(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    /* Copy the ring so the VR thread isn't held up while the file is written */
+    std::vector<VRFrameSample> frames;
+    {
+        QMutexLocker locker(&mutex);
+        qint64 count = std::min<qint64>(written, capacity);
+        frames.reserve(std::size_t(count));
+        for (qint64 i = written - count; i < written; i++)
+            frames.push_back(samples[i % capacity]);
+    }
+
+    QTextStream out(&file);
+    out << "frame,interval_ms,render_ms,drain_ms,actors_ms,inputs_ms,syncs_ms\n";
+    for (std::size_t i = 0; i < frames.size(); i++)
+    {
+        const VRFrameSample &frame = frames[i];
+        out << i << ',' << toMilliseconds(frame.interval) << ',' << toMilliseconds(frame.render) << ','
+            << toMilliseconds(frame.drain) << ',' << toMilliseconds(frame.actors) << ','
+            << toMilliseconds(frame.inputs) << ',' << toMilliseconds(frame.syncs) << '\n';
+    }
+    return out.status() == QTextStream::Ok;
+}
@@ -0,0 +1,97 @@
+/**     @file VRFrameStats.h
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief Per-frame timings of the VR loop and a summary of them
+ */
+
+#ifndef VIEWER_VRFRAMESTATS_H
+#define VIEWER_VRFRAMESTATS_H
+
+#include <QMetaType>
+#include <QMutex>
+#include <QString>
+
+#include <array>
+
+/**
+ * @brief How long one frame of the VR loop took and where the time went, all in nanoseconds
+ */
+struct VRFrameSample
+{
+  qint64 interval = 0; /**< Time since the previous frame started */
+  qint64 render = 0;   /**< Drawing the frame and processing headset events */
+  qint64 drain = 0;    /**< Draining the command queue */
+  qint64 actors = 0;   /**< Adding and removing actors */
+  qint64 inputs = 0;   /**< Swapping in filtered meshes and section changes */
+  qint64 syncs = 0;    /**< Applying colour and visibility changes */
+};
+
+/**
+ * @brief Frame time percentiles over the recent frames
+ */
+struct VRFrameSummary
+{
+  double p50 = 0.;         /**< Median frame time in milliseconds */
+  double p95 = 0.;         /**< 95th percentile frame time in milliseconds */
+  double p99 = 0.;         /**< 99th percentile frame time in milliseconds */
+  double budget = 0.;      /**< Time one frame should take in milliseconds */
+  int frames = 0;          /**< Number of frames the percentiles cover */
+  qint64 missed = 0;       /**< Frames that missed their deadline since the previous summary */
+  qint64 missedTotal = 0;  /**< Frames that missed their deadline this session */
+};
+Q_DECLARE_METATYPE(VRFrameSummary)
+
+/**
+ * @class VRFrameStats
+ * @brief Keeps the timings of the most recent VR frames in a fixed ring buffer
+ *
+ * The VR thread records one sample per frame, which costs a copy and an uncontended lock, nothing is
+ * allocated. Any thread can summarise or dump the buffer.
+ */
+class VRFrameStats
+{
+public:
+  /** Number of frames kept, about 45 seconds at 90 Hz */
+  static const int capacity = 4096;
+
+  /**
+   * @brief Constructor
+   */
+  VRFrameStats();
+
+  /**
+   * @brief Forget every frame, e.g. when a session starts
+   * @param budget Time one frame should take, in nanoseconds
+   */
+  void reset(qint64 budget);
+
+  /**
+   * @brief Add a frame, overwriting the oldest once the buffer is full
+   * @param sample The frame's timings
+   */
+  void record(const VRFrameSample &sample);
+
+  /**
+   * @brief Work out the frame time percentiles of the frames in the buffer
+   * @return the summary, its missed count covers the frames since the previous call
+   */
+  VRFrameSummary summarise();
+
+  /**
+   * @brief Write the frames in the buffer to a CSV file, oldest first
+   * @param fileName The file to write
+   * @return false if the file couldn't be written
+   */
+  bool dump(const QString &fileName);
+
+private:
+  QMutex mutex;                                 /**< Guards everything below */
+  std::array<VRFrameSample, capacity> samples;  /**< The ring */
+  qint64 written;                               /**< Frames recorded since reset(), the next slot is written % capacity */
+  qint64 frameBudget;                           /**< Time one frame should take */
+  qint64 missed;                                /**< Missed frames since the previous summary */
+  qint64 missedTotal;                           /**< Missed frames since reset() */
+};
+
+#endif
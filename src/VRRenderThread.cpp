@@ -8,13 +8,10 @@
  */
 
 #include "VRRenderThread.h"
+#include "OpenVRBackend.h"
 
 /* Vtk headers */
 #include <vtkActor.h>
-#include <vtkOpenVRRenderWindow.h>
-#include <vtkOpenVRRenderWindowInteractor.h>
-#include <vtkOpenVRRenderer.h>
-#include <vtkOpenVRCamera.h>
 
 #include <vtkNew.h>
 #include <vtkSmartPointer.h>
@@ -25,6 +22,21 @@
 #include <vtkSTLReader.h>
 #include <vtkDataSetmapper.h>
 #include <vtkCallbackCommand.h>
+#include <vtkPlaneCollection.h>
+
+#include <algorithm>
+
+namespace
+{
+	/* Nanoseconds since t, and moves t on to now so stages can be timed one after another */
+	qint64 lap(std::chrono::steady_clock::time_point &t)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		qint64 elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - t).count();
+		t = now;
+		return elapsed;
+	}
+}
 
 /* The class constructor is called by MainWindow and runs in the primary program thread, this thread
  * will go on to handle the GUI (mouse clicks, etc). The OpenVRRenderWindowInteractor cannot be start()ed
@@ -33,20 +45,37 @@
  */
 VRRenderThread::VRRenderThread(QObject* parent)
 {
-	/* Initialise actor list */
-	actors = vtkActorCollection::New();
-
 	/* Initialise command variables */
 	rotateX = 0.;
 	rotateY = 0.;
 	rotateZ = 0.;
 	endRender = true;
-	syncRender = false;
-	removeFiltersFlag = false;
 	actorsChanged = false;
-
-	// TODO how do we initialise the command enum
-
+	actorsDirty = false;
+	inputsPending = false;
+	sectionsPending = false;
+	lastCommandLatency = 0;
+	queueFullReported = false;
+	resumeIssued = 0;
+	quitRequested = false;
+	paused = false;
+	workBudget = 2000000;
+	uploadBudget = 250000;
+
+	/* Summaries are emitted from the VR thread */
+	qRegisterMetaType<VRFrameSummary>("VRFrameSummary");
+
+	/* Draw to a real headset unless told otherwise */
+	backend.reset(new OpenVRBackend());
+
+	/* The scene starts unrotated */
+	sceneTransform = vtkSmartPointer<vtkTransform>::New();
+	sceneTransform->PreMultiply();
+
+	/* The section plane starts at the origin */
+	sectionOffset = 0.;
+	sectionPlane = vtkSmartPointer<vtkPlane>::New();
+	placeSectionPlane();
 }
 
 /* Standard destructor - this is important here as the class will be destroyed when the user
@@ -56,25 +85,90 @@ VRRenderThread::VRRenderThread(QObject* parent)
  */
 VRRenderThread::~VRRenderThread()
 {
+	/* The thread may still be running or paused */
+	shutdown();
+
 	/* Check if things exist before removing them */
-	if (actors != nullptr)
+	if (renderer != nullptr)
 	{
-		actors->InitTraversal();
-		vtkActor* actor;
-		while ((actor = (vtkActor*)actors->GetNextActor()))
-		{
-			renderer->RemoveActor(actor);
-		}
-		actors->Delete();
+		for (const auto &entry : actors)
+			renderer->RemoveActor(entry.first);
 	}
-	if (renderer != nullptr)
-		renderer->Delete();
-	if (window != nullptr)
-		window->Delete();
-	if (camera != nullptr)
-		camera->Delete();
-	if (interactor != nullptr)
-		interactor->Delete();
+	actors.clear();
+}
+
+void VRRenderThread::setBackend(VRBackend *newBackend)
+{
+	if (this->isRunning() && !isPaused())
+	{
+		emit sendVRMessage("Stop VR before changing the headset");
+		delete newBackend;
+		return;
+	}
+
+	/* A paused session belongs to the old backend, so it is closed first */
+	shutdown();
+	backend.reset(newBackend);
+}
+
+void VRRenderThread::startRendering()
+{
+	/* Parts edited while VR was stopped were never synced, so every actor is sent its part's
+	 * colour and visibility before the first frame
+	 */
+	QMutexLocker locker(&mutex);
+	for (const auto &entry : actorMap)
+		markDirty(entry.first, entry.second);
+
+	/* Pausing and resuming go through flags rather than the queue, so they can't be dropped when it is
+	 * full. The latest request wins, a quick stop/start leaves VR running
+	 */
+	endRender = false;
+
+	if (!this->isRunning())
+	{
+		quitRequested = false;
+		start();
+		return;
+	}
+
+	/* Set under the mutex, so a thread about to wait can't miss the wake */
+	if (paused)
+		resumeIssued = VRCommandQueue::now();
+	condition.wakeAll();
+}
+
+void VRRenderThread::shutdown()
+{
+	if (!this->isRunning())
+		return;
+
+	{
+		QMutexLocker locker(&mutex);
+		quitRequested = true;
+		condition.wakeAll();
+	}
+	wait();
+}
+
+bool VRRenderThread::isPaused() const
+{
+	return paused;
+}
+
+void VRRenderThread::applyAllQueued()
+{
+	FrameBudget unlimited = unlimitedBudget();
+
+	mutex.lock();
+	applyActorQueues(true, unlimited);
+	actorsChanged = false;
+	mutex.unlock();
+
+	actorsDirty = true;
+	applyActorSyncs(unlimited);
+	applyInputs(unlimited);
+	applySections(unlimited);
 }
 
 void VRRenderThread::addActor(vtkActor *actor, ModelPart *part)
@@ -82,7 +176,6 @@ void VRRenderThread::addActor(vtkActor *actor, ModelPart *part)
 	QMutexLocker locker(&mutex);
 
         actorMap[actor] = part;
-        part->setOriginalData(actor->GetMapper()->GetInput());
 
 		/* I have found that these initial transforms will position the FS
 		 * car model in a sensible position but you can experiment
@@ -93,25 +186,28 @@ void VRRenderThread::addActor(vtkActor *actor, ModelPart *part)
 
 		// These transforms break it, so I just removed them for now -> with more time this would be implemented
 
-    if (!this->isRunning())
-    {	
-		/* Only add the actor to the collection if it's not already present */
-		if (!actors->IsItemPresent(actor))
-		{
-			actors->AddItem(actor);
-		}
-    }
-    else
-    {
-        /* If the VR thread is running, add the actor to a queue
-        * The VR thread will later add these actors to the scene
-		* Only add the actor to the queue if it's not already present in the queue
-		*/
-		if (std::find(actorQueue.begin(), actorQueue.end(), actor) == actorQueue.end())
-		{
-			actorQueue.push_back(actor);
+	if (!this->isRunning())
+	{
+		/* Parts are turned with the rest of the scene. Only safe here while the VR thread isn't
+		 * rotating the transform, otherwise it is set when the actor is taken off the queue
+		 */
+		actor->SetUserTransform(sceneTransform);
+
+		/* Changes queued while the last session was ending are overridden */
+		actorsToRemove.erase(actor);
+		actors.emplace(actor, actor);
+	}
+	else
+	{
+		/* If the VR thread is running, queue the actor and the VR thread will later add it to the scene.
+		 * An actor queued for removal is still in the scene, so cancelling the removal is enough.
+		 * The VR loop is only told once, however many actors are queued before it next looks
+		 */
+		bool wasQueued = !actorsToAdd.empty() || !actorsToRemove.empty();
+		if (actorsToRemove.erase(actor) == 0)
+			actorsToAdd.emplace(actor, actor);
+		if (!wasQueued && !actorsToAdd.empty())
 			issueCommand(VRRenderThread::ACTORS_CHANGED);
-		}
 	}
 }
 
@@ -120,6 +216,10 @@ void VRRenderThread::removeActor(vtkActor* actor)
 	QMutexLocker locker(&mutex);
 	
 	// remove actor from actorMap
+	dirtyActors.erase(actor);
+	pendingInputs.erase(actor);
+	pendingSections.erase(actor);
+	sectionedActors.erase(actor);
 	if (actorMap.count(actor) > 0)
 		actorMap.erase(actor);
 	else
@@ -127,128 +227,368 @@ void VRRenderThread::removeActor(vtkActor* actor)
 	
 	if (!this->isRunning())
 	{
-		// remove item from actor collection
-		if (actors->IsItemPresent(actor))
-		{
-			int sizeBefore = actors->GetNumberOfItems();
-			actors->RemoveItem(actor);
-			int sizeAfter = actors->GetNumberOfItems();
-
-			if (sizeBefore == sizeAfter)
-			{
-				emit sendVRMessage("Actor was not removed from collection");
-			}
-			else if (actors->IsItemPresent(actor))
-			{
-				emit sendVRMessage("Actor is still in collection after removal");
-			}
-		}
-		else
+		actorsToAdd.erase(actor);
+		setSectionPlane(actor, false);
+		if (actors.erase(actor) == 0)
 			emit sendVRMessage("Actor not found in actor collection (while offline)");
 	}
 	else
 	{
-		/* If the VR thread is running, add the actor to a queue
-		* The VR thread will later remove these actors from the scene 
-		*/
-		RemoveActorQueue.push_back(actor);
-		issueCommand(VRRenderThread::ACTORS_CHANGED);
+		/* If the VR thread is running, queue the actor and the VR thread will later remove it from the scene.
+		 * An actor still waiting to be added never reached the scene, so it is just dropped from that queue
+		 */
+		bool wasQueued = !actorsToAdd.empty() || !actorsToRemove.empty();
+		if (actorsToAdd.erase(actor) == 0)
+			actorsToRemove.insert(actor);
+		if (!wasQueued && !actorsToRemove.empty())
+			issueCommand(VRRenderThread::ACTORS_CHANGED);
 	}
 }
 
 void VRRenderThread::issueCommand(int cmd, double value)
 {
+	/* Filters are taken off on this thread, whether or not VR is running */
+	if (cmd == REMOVE_FILTERS)
+	{
+		removeFilters();
+		return;
+	}
 
-	/* Update class variables according to command */
-	switch (cmd)
+	/* Pauses VR at the end of the current frame, startRendering() resumes it */
+	if (cmd == END_RENDER)
 	{
+		QMutexLocker locker(&mutex);
+		endRender = true;
+		return;
+	}
 
-	case END_RENDER:
-		this->endRender = true;
-		break;
+	/* Nothing drains the queue while VR is stopped, but the plane can be moved straight away */
+	if (!this->isRunning())
+	{
+		if (cmd == SECTION_OFFSET)
+		{
+			sectionOffset = value;
+			placeSectionPlane();
+		}
+		return;
+	}
 
-	case ROTATE_X:
-		this->rotateX = value;
-		break;
+	/* A full sync marks every part dirty, the values are read here on the GUI thread */
+	if (cmd == SYNC_RENDER)
+	{
+		QMutexLocker locker(&mutex);
+		for (const auto &entry : actorMap)
+			markDirty(entry.first, entry.second);
+		return;
+	}
 
-	case ROTATE_Y:
-		this->rotateY = value;
-		break;
+	VRCommand command;
+	command.type = cmd;
+	command.value = value;
+	command.issued = VRCommandQueue::now();
+	pushCommand(command);
+}
 
-	case ROTATE_Z:
-		this->rotateZ = value;
-		break;
+void VRRenderThread::syncActor(ModelPart *part)
+{
+	if (!this->isRunning() || !part)
+		return;
+
+	QMutexLocker locker(&mutex);
+	vtkActor *actor = part->getVRActor();
+	if (actorMap.count(actor) > 0)
+		markDirty(actor, part);
+}
 
-	case SYNC_RENDER:
-		this->syncRender = true;
-		break;
+void VRRenderThread::markDirty(vtkActor *actor, ModelPart *part)
+{
+	/* The VR loop is only told once, however many parts change before it next looks */
+	if (dirtyActors.empty())
+		issueCommand(VRRenderThread::SYNC_ACTORS);
 
-	case REMOVE_FILTERS:
-		this->removeFiltersFlag = true;
-		break;
-	
-	case ACTORS_CHANGED:
-		this->actorsChanged = true;
-		break;
+	dirtyActors[actor] = {part->colour().rgb(), part->visible()};
+}
+
+qint64 VRRenderThread::commandLatency() const
+{
+	return lastCommandLatency.load(std::memory_order_relaxed);
+}
+
+void VRRenderThread::pushCommand(const VRCommand &command)
+{
+	/* Reported once rather than for every command dropped while the queue stays full */
+	if (commands.push(command))
+		queueFullReported = false;
+	else if (!queueFullReported)
+	{
+		emit sendVRMessage("VR command queue full, commands dropped");
+		queueFullReported = true;
+	}
+
+	/* A paused loop waits on the condition, it drains the queue when woken */
+	condition.wakeAll();
+}
+
+void VRRenderThread::drainCommands()
+{
+	VRCommand command;
+	qint64 oldest = 0;
+
+	while (commands.pop(command))
+	{
+		if (oldest == 0)
+			oldest = command.issued;
+
+		/* Later commands of the same kind replace earlier ones, only the latest state matters */
+		switch (command.type)
+		{
+
+		case ROTATE_X:
+			this->rotateX = command.value;
+			break;
+
+		case ROTATE_Y:
+			this->rotateY = command.value;
+			break;
+
+		case ROTATE_Z:
+			this->rotateZ = command.value;
+			break;
+
+		case SWAP_INPUTS:
+			this->inputsPending = true;
+			break;
+
+		case SECTIONS_CHANGED:
+			this->sectionsPending = true;
+			break;
+
+		case SECTION_OFFSET:
+			/* The mappers read the plane as they draw, so moving it is all that's needed */
+			sectionOffset = command.value;
+			placeSectionPlane();
+			break;
+
+		case ACTORS_CHANGED:
+			this->actorsChanged = true;
+			break;
+
+		case SYNC_ACTORS:
+			this->actorsDirty = true;
+			break;
+		}
+	}
+
+	if (oldest != 0)
+		lastCommandLatency.store(VRCommandQueue::now() - oldest, std::memory_order_relaxed);
+}
+
+VRRenderThread::FrameBudget VRRenderThread::unlimitedBudget()
+{
+	FrameBudget budget;
+	budget.deadline = std::chrono::steady_clock::time_point::max();
+	budget.cells = std::numeric_limits<vtkIdType>::max();
+	return budget;
+}
+
+void VRRenderThread::setWorkBudget(double milliseconds)
+{
+	workBudget = qint64(milliseconds * 1e6);
+}
+
+void VRRenderThread::setUploadBudget(vtkIdType cells)
+{
+	uploadBudget = cells;
+}
+
+void VRRenderThread::applyActorSyncs(FrameBudget &budget)
+{
+	if (!actorsDirty)
+		return;
+
+	/* Held throughout, so none of the actors can be removed while they are updated */
+	QMutexLocker locker(&mutex);
+	bool first = true;
+	auto it = dirtyActors.begin();
+	while (it != dirtyActors.end() && (first || !budget.spent()))
+	{
+		QRgb colour = it->second.colour;
+		it->first->GetProperty()->SetColor(qRed(colour) / 255., qGreen(colour) / 255., qBlue(colour) / 255.);
+		it->first->SetVisibility(it->second.visible);
+		it = dirtyActors.erase(it);
+		first = false;
+	}
+
+	/* The GUI only sends another SYNC_ACTORS once the map is empty, so leftovers keep the flag up */
+	actorsDirty = !dirtyActors.empty();
+}
+
+void VRRenderThread::applyActorQueues(bool inScene, FrameBudget &budget)
+{
+	bool first = true;
+
+	/* Removals free memory and never upload anything, so they go first */
+	auto removal = actorsToRemove.begin();
+	while (removal != actorsToRemove.end() && (first || !budget.spent()))
+	{
+		vtkActor *actor = *removal;
+		removal = actorsToRemove.erase(removal);
+		first = false;
+
+		auto it = actors.find(actor);
+		if (it == actors.end())
+		{
+			emit sendVRMessage("Actor not found in actor collection");
+			continue;
+		}
+
+		/* The actor may come back later without a section */
+		setSectionPlane(actor, false);
+		if (inScene)
+			renderer->RemoveActor(actor);
+		actors.erase(it);
+	}
+
+	auto addition = actorsToAdd.begin();
+	while (addition != actorsToAdd.end() && (first || !budget.spent()))
+	{
+		/* Reads the scene transform, which only this thread changes */
+		addition->first->SetUserTransform(sceneTransform);
+
+		if (actors.insert(*addition).second && inScene)
+		{
+			/* Its mesh is uploaded as the next frame draws */
+			renderer->AddActor(addition->first);
+			vtkDataSet *data = addition->first->GetMapper()->GetInputAsDataSet();
+			if (data != nullptr)
+				budget.cells -= data->GetNumberOfCells();
+		}
+		addition = actorsToAdd.erase(addition);
+		first = false;
 	}
 }
 
-void VRRenderThread::applyShrinkFilter(ModelPart *selectedPart)
+void VRRenderThread::setFilteredInput(vtkActor *actor, vtkSmartPointer<vtkPolyData> input)
 {
 	QMutexLocker locker(&mutex);
+	if (actorMap.count(actor) > 0)
+		queueInput(actor, input);
+}
+
+void VRRenderThread::setSectioned(vtkActor *actor, bool sectioned)
+{
+	QMutexLocker locker(&mutex);
+	if (actorMap.count(actor) == 0)
+		return;
+
+	/* Only changes are passed on */
+	bool current = sectionedActors.count(actor) > 0;
+	if (current == sectioned)
+		return;
+
+	if (sectioned)
+		sectionedActors.insert(actor);
+	else
+		sectionedActors.erase(actor);
+
 	if (!this->isRunning())
 	{
-		emit sendVRMessage("VR thread not running");
+		setSectionPlane(actor, sectioned);
 		return;
 	}
 
-	/* Define and apply shrink filter */
-	vtkActor *a = selectedPart->getVRActor();
-	vtkSmartPointer<vtkShrinkFilter> shrinkFilter = vtkSmartPointer<vtkShrinkFilter>::New();
-	shrinkFilter->SetInputData(a->GetMapper()->GetInput());
-	shrinkFilter->SetShrinkFactor(0.5);
-	shrinkFilter->Update();
-	a->GetMapper()->SetInputConnection(shrinkFilter->GetOutputPort());
+	if (pendingSections.empty())
+		issueCommand(VRRenderThread::SECTIONS_CHANGED);
+	pendingSections[actor] = sectioned;
 }
 
-void VRRenderThread::applyClipFilter(ModelPart *selectedPart)
+void VRRenderThread::setSectionPlane(vtkActor *actor, bool sectioned)
+{
+	vtkMapper *mapper = actor->GetMapper();
+	bool present = mapper->GetClippingPlanes() != nullptr && mapper->GetClippingPlanes()->IsItemPresent(sectionPlane);
+
+	if (sectioned && !present)
+		mapper->AddClippingPlane(sectionPlane);
+	else if (!sectioned && present)
+		mapper->RemoveClippingPlane(sectionPlane);
+}
+
+void VRRenderThread::placeSectionPlane()
+{
+	/* Clipping planes are in world coordinates, so the plane is turned with the scene to cut the
+	 * parts where the desktop section does
+	 */
+	double offset[3] = {sectionOffset, 0., 0.};
+	double origin[3];
+	double normal[3];
+	sceneTransform->TransformPoint(offset, origin);
+	sceneTransform->TransformNormal(sectionNormal, normal);
+	sectionPlane->SetOrigin(origin);
+	sectionPlane->SetNormal(normal);
+}
+
+void VRRenderThread::applySections(FrameBudget &budget)
 {
 	QMutexLocker locker(&mutex);
+	bool first = true;
+	auto it = pendingSections.begin();
+	while (it != pendingSections.end() && (first || !budget.spent()))
+	{
+		if (actorMap.count(it->first) > 0)
+			setSectionPlane(it->first, it->second);
+		it = pendingSections.erase(it);
+		first = false;
+	}
+	sectionsPending = !pendingSections.empty();
+}
+
+void VRRenderThread::removeFilters()
+{
+	QMutexLocker locker(&mutex);
+
+	/* Point each mapper back at its part's mesh, the filters never changed it */
+	for (const auto &entry : actorMap)
+		queueInput(entry.first, entry.second->getVRPolyData());
+}
+
+bool VRRenderThread::dumpFrameStats(const QString &fileName)
+{
+	return frameStats.dump(fileName);
+}
+
+void VRRenderThread::queueInput(vtkActor *actor, vtkSmartPointer<vtkPolyData> input)
+{
+	/* Nothing else draws the actor while VR is stopped */
 	if (!this->isRunning())
 	{
-		emit sendVRMessage("VR thread not running");
+		actor->GetMapper()->SetInputDataObject(input);
 		return;
 	}
 
-	/* Define and apply clip filter 
-	* NB: These values are entirely arbitrary and just clip filter the entire model at the moment
-	*/
-	vtkSmartPointer<vtkActor> a = selectedPart->getVRActor();
-	vtkSmartPointer<vtkPlane> plane = vtkSmartPointer<vtkPlane>::New();
-	plane->SetOrigin(0, 0, 0);
-	plane->SetNormal(-1, 0, 0);
-	vtkSmartPointer<vtkClipDataSet> clipFilter = vtkSmartPointer<vtkClipDataSet>::New();
-	clipFilter->SetInputData(a->GetMapper()->GetInput());
-	clipFilter->SetClipFunction(plane.Get());
-	clipFilter->Update();
-	a->GetMapper()->SetInputConnection(clipFilter->GetOutputPort());
+	if (pendingInputs.empty())
+		issueCommand(VRRenderThread::SWAP_INPUTS);
+
+	pendingInputs[actor] = input;
 }
 
-void VRRenderThread::removeFilters()
+void VRRenderThread::applyInputs(FrameBudget &budget)
 {
 	QMutexLocker locker(&mutex);
-	vtkActorCollection *actorList = renderer->GetActors();
-	vtkActor *a;
-	actorList->InitTraversal();
-	while ((a = (vtkActor *)actorList->GetNextActor()))
+	bool first = true;
+	auto it = pendingInputs.begin();
+	while (it != pendingInputs.end() && (first || !budget.spent()))
 	{
-		if (a != nullptr)
+		/* Skip actors removed since the input was queued */
+		if (actorMap.count(it->first) > 0)
 		{
-			vtkSmartPointer<vtkTrivialProducer> producer = vtkSmartPointer<vtkTrivialProducer>::New();
-			producer->SetOutput(actorMap[a]->getOriginalData());
-			a->GetMapper()->SetInputConnection(producer->GetOutputPort());
+			/* The new mesh is uploaded as the next frame draws */
+			it->first->GetMapper()->SetInputDataObject(it->second);
+			budget.cells -= it->second->GetNumberOfCells();
 		}
+		it = pendingInputs.erase(it);
+		first = false;
 	}
+	inputsPending = !pendingInputs.empty();
 }
 
 /* This function runs in a separate thread. This means that the program
@@ -270,40 +610,25 @@ void VRRenderThread::run()
 	std::array<unsigned char, 4> bkg{{26, 51, 102, 255}};
 	colors->SetColor("BkgColor", bkg.data());
 
-	// The renderer generates the image
-	// which is then displayed on the render window.
-	// It can be thought of as a scene to which the actor is added
-	renderer = vtkOpenVRRenderer::New();
-
-	renderer->SetBackground(colors->GetColor3d("BkgColor").GetData());
-
-	/* Loop through list of actors provided and add to scene */
-	vtkActor *a;
-	actors->InitTraversal();
-	while ((a = (vtkActor *)actors->GetNextActor()))
-	{
-		renderer->AddActor(a);
-	}
-	int items = renderer->GetActors()->GetNumberOfItems();
-	int collectionSize = actors->GetNumberOfItems();
-
-	/* The render window is the actual GUI window
-	 * that appears on the computer screen
-	 */
-	window = vtkOpenVRRenderWindow::New();
-
-	if (!window->IsHMDPresent())
+	/* The backend creates the renderer, window and camera for the headset (or its stand-in) */
+	if (!backend->initialise())
 	{
-		emit sendVRMessage("No HMD detected");
+		emit sendVRMessage(backend->error());
 		return;
 	}
+	renderer = backend->renderer();
 
-	window->Initialize();
-	window->AddRenderer(renderer);
+	renderer->SetBackground(colors->GetColor3d("BkgColor").GetData());
 
-	/* Create Open VR Camera */
-	camera = vtkOpenVRCamera::New();
-	renderer->SetActiveCamera(camera);
+	/* Loop through list of actors provided and add to scene, including any changes
+	 * queued while the previous session was ending
+	 */
+	FrameBudget setup = unlimitedBudget();
+	mutex.lock();
+	applyActorQueues(false, setup);
+	for (const auto &entry : actors)
+		renderer->AddActor(entry.first);
+	mutex.unlock();
 
 	/* Create a light */
 	vtkSmartPointer<vtkLight> light = vtkSmartPointer<vtkLight>::New();
@@ -349,173 +674,156 @@ void VRRenderThread::run()
 	*/
 
 
-	/* The render window interactor captures mouse events
-	 * and will perform appropriate camera or actor manipulation
-	 * depending on the nature of the events.
-	 */
-	interactor = vtkOpenVRRenderWindowInteractor::New();
-	interactor->SetRenderWindow(window);
-	interactor->Initialize();
-	window->Render();
-
 	/* Now start the VR - we will implement the command loop manually
 	 * so it can be interrupted to make modifications to the actors
 	 * (i.e. to implement animation)
 	 */
-	endRender = false;
-	t_last = std::chrono::steady_clock::now();
+	/* Throw away anything left over from the previous time the thread ran */
+	VRCommand stale;
+	while (commands.pop(stale))
+		;
+	rotateX = rotateY = rotateZ = 0.;
+
+	qint64 frameInterval = qint64(1e9 / backend->refreshRate());
+	qint64 resumeStart = 0;
 
-	while (!interactor->GetDone() && !this->endRender)
+	/* Each pass is one session, END_RENDER pauses between sessions and keeps the window, renderer and
+	 * everything uploaded to the GPU, so resuming costs about a frame
+	 */
+	while (true)
 	{
-		interactor->DoOneEvent(window, renderer);
-
-		/* Check to see if enough time has elapsed since last update
-		 * This looks overcomplicated (and it is, C++ loves to make things unecessarily complicated!) but
-		 * is really just checking if more than 20ms have elaspsed since the last animation step. The
-		 * complications comes from the fact that numbers representing time on computers don't usually have
-		 * standard second/millisecond units. Because everything is a class in C++, the converion from
-		 * computer units to seconds/milliseconds ends up looking like what you see below.
-		 *
-		 * My choice of 20ms is arbitrary, if this value is too small the animation calculations could begin to
-		 * interfere with the interator processes and make the simulation unresponsive. If it is too large
-		 * the animations will be jerky. Play with the value to see what works best.
+		/* Catch up on everything queued since the last session, before the first frame */
+		applyAllQueued();
+		t_last = std::chrono::steady_clock::now();
+
+		/* Frame timings start afresh each session */
+		frameStats.reset(frameInterval);
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::time_point lastSummary = frameStart;
+
+		/* Each frame, once the headset has been given its frame, the queued changes are worked through until
+		 * the frame's budget is used up or the next frame is due, whichever comes first. Anything left over
+		 * waits for the next frame, so a large batch of changes is spread out rather than dropping frames.
 		 */
-		if (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t_last).count() > 20)
+		while (!backend->isDone() && !this->endRender && !quitRequested)
 		{
+			VRFrameSample sample;
+			std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+			sample.interval = std::chrono::duration_cast<std::chrono::nanoseconds>(t - frameStart).count();
+			frameStart = t;
+
+			backend->doOneFrame();
+			sample.render = lap(t);
+
+			if (resumeStart != 0)
+			{
+				emit sendVRMessage(QString("VR resumed in %1 ms").arg((VRCommandQueue::now() - resumeStart) / 1e6, 0, 'f', 1));
+				resumeStart = 0;
+			}
+
+			/* Stop at the end of the work budget, or earlier if the next frame is already due */
+			std::chrono::steady_clock::time_point workEnd = t + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(workBudget.load()));
+			std::chrono::steady_clock::time_point frameEnd = frameStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(frameInterval));
+			FrameBudget budget;
+			budget.deadline = std::min(workEnd, frameEnd);
+			budget.cells = uploadBudget.load();
+
+			/* Pick up everything the GUI has asked for since the last frame */
+			drainCommands();
+			sample.drain = lap(t);
+
 			/* Do things that might need doing ... */
-			vtkActorCollection *actorList = renderer->GetActors();
-			vtkActor *a;
 
-			/* adds a tiny animation */
-			rotateX += 0.1;
+			/* adds a tiny animation, 5 degrees a second whatever the frame rate */
+			rotateX += 5. * std::chrono::duration<double>(t - t_last).count();
+			t_last = t;
 
-			/* Rotation */
-			actorList->InitTraversal();
-			while ((a = (vtkActor *)actorList->GetNextActor()))
+			/* Rotation - one change to the shared transform turns every part, however many there are */
+			if (rotateX != 0. || rotateY != 0. || rotateZ != 0.)
 			{
-				if (a != nullptr)
-				{
-					a->RotateX(rotateX);
-					a->RotateY(rotateY);
-					a->RotateZ(rotateZ);
-				}
+				sceneTransform->RotateX(rotateX);
+				sceneTransform->RotateY(rotateY);
+				sceneTransform->RotateZ(rotateZ);
+				placeSectionPlane();
 			}
 			rotateX = 0;
 			rotateY = 0;
 			rotateZ = 0;
 
-			if (syncRender)
+			if (actorsChanged)
 			{
+				/* Only the queued actors are touched, the rest of the scene stays as it is */
 				mutex.lock();
-
-				/* Update all actors */
-				actors->InitTraversal();
-				vtkActor *actor = nullptr;
-				while ((actor = actors->GetNextActor()) != nullptr)
-				{
-					ModelPart *part = actorMap[actor];
-					QColor colour = part->colour();
-					bool visible = part->visible();
-					actor->GetProperty()->SetColor(colour.redF(), colour.greenF(), colour.blueF());
-					actor->SetVisibility(visible);
-				}
-
-				/* Reset the command */
-				syncRender = false;
+				applyActorQueues(true, budget);
+				actorsChanged = !actorsToAdd.empty() || !actorsToRemove.empty();
 				mutex.unlock();
 			}
+			sample.actors = lap(t);
 
-			if (actorsChanged)
-			{
-				mutex.lock();
+			/* Colour/visibility of the parts edited since the last frame */
+			applyActorSyncs(budget);
+			sample.syncs = lap(t);
 
-				/* If an actor is in the remove queue, remove it from the actor collection */
-				while (!RemoveActorQueue.empty())
-				{
-					vtkActor* actor = RemoveActorQueue.front();
-					RemoveActorQueue.pop_front();
-
-					/* Remove the actor from the actor collection */
-					if (actors->IsItemPresent(actor))
-						actors->RemoveItem(actor);
-					else 
-						emit sendVRMessage("Actor not found in actor collection");
-					/* Delete the actor */
-					//actor->Delete(); -> unneeded, actor is a smart pointer
-				}
-
-				/* Add actors from actorQueue to actors collection */
-				while (!actorQueue.empty())
-				{
-					vtkActor* actor = actorQueue.front();
-					actorQueue.pop_front();
-
-					if (!actors->IsItemPresent(actor))
-						actors->AddItem(actor);
-				}
-
-
-				/* remove all actors from renderer */
-				vtkActorCollection* actorList = renderer->GetActors();
-				vtkActor* a;
-				actorList->InitTraversal();
-				while ((a = (vtkActor*)actorList->GetNextActor()))
-				{
-					if (a != nullptr)
-					{
-						renderer->RemoveActor(a);
-					}
-				}
-
-				/* add actors from actors collection to renderer */
-				actors->InitTraversal();
-				while ((a = (vtkActor*)actors->GetNextActor()))
-				{
-					if (a != nullptr)
-					{
-						renderer->AddActor(a);
-					}
-				}
-
-				actorsChanged = false;
-				mutex.unlock();
-			}
+			/* Filtered meshes are swapped in here, between frames */
+			if (inputsPending)
+				applyInputs(budget);
+
+			if (sectionsPending)
+				applySections(budget);
+			sample.inputs = lap(t);
 
-			if (removeFiltersFlag)
+			frameStats.record(sample);
+
+			if (frameStart - lastSummary > std::chrono::seconds(1))
 			{
-				removeFilters();
-				removeFiltersFlag = false;
+				emit frameStatsUpdated(frameStats.summarise());
+				lastSummary = frameStart;
 			}
-
-			/* Remember time now */
-			t_last = std::chrono::steady_clock::now();
 		}
-	}
-	/* This is now after rendering has stopped: */
+		/* This is now after rendering has stopped: */
 
-	/* Delete the actors from renderer */
-	vtkActorCollection *actorList = renderer->GetActors();
-	actorList->InitTraversal();
-	while ((a = (vtkActor *)actorList->GetNextActor()))
-	{
-		if (a != nullptr)
-		{
-			a->Delete();
-		}
-	}
+		/* The frames since the last summary, so a short session is still reported */
+		emit frameStatsUpdated(frameStats.summarise());
 
-	/* Delete the actors from the actor collection */
-	actors->InitTraversal();
-	while ((a = (vtkActor *)actors->GetNextActor()))
-	{
-		if (a != nullptr)
+		if (backend->isDone() || quitRequested)
+			break;
+
+		/* Paused: nothing is drawn, but the scene stays as it is. Changes keep being queued and are
+		 * applied when the next session starts. Every command pushed wakes the thread so the queue is
+		 * drained as it fills, startRendering() clears endRender again
+		 */
+		mutex.lock();
+		paused = true;
+		drainCommands();
+		while (this->endRender && !quitRequested)
 		{
-			a->Delete();
+			condition.wait(&mutex);
+			drainCommands();
 		}
+		paused = false;
+		resumeStart = resumeIssued;
+		resumeIssued = 0;
+		mutex.unlock();
+
+		if (quitRequested)
+			break;
 	}
 
+	/* The actors belong to their model parts, so they are only removed from the scene here
+	 * (they stay in the actor collection, ready for VR to be started again)
+	 */
+
+	/* Anything still queued is applied straight away from now on */
+	mutex.lock();
+	FrameBudget remaining = unlimitedBudget();
+	applyActorQueues(false, remaining);
+	mutex.unlock();
+	applyInputs(remaining);
+	applySections(remaining);
+
 	/* Close the window and clean up */
-	window->Finalize();
 	renderer->RemoveAllViewProps();
 	renderer->RemoveAllLights();
+	backend->finalise();
+	renderer = nullptr;
 }
\ No newline at end of file
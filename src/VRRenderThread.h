@@ -13,18 +13,19 @@
 
 /* Project headers */
 #include "ModelPart.h"
+#include "VRCommandQueue.h"
+#include "VRBackend.h"
+#include "VRFrameStats.h"
 
 /* Qt headers */
 #include <QThread>
 #include <QMutex>
 #include <QWaitCondition>
+#include <QRgb>
 
 /* Vtk headers */
 #include <vtkActor.h>
-#include <vtkOpenVRRenderWindow.h>
-#include <vtkOpenVRRenderWindowInteractor.h>
-#include <vtkOpenVRRenderer.h>
-#include <vtkOpenVRCamera.h>
+#include <vtkRenderer.h>
 #include <vtkActorCollection.h>
 #include <vtkCommand.h>
 #include <vtkLight.h>
@@ -32,13 +33,16 @@
 #include <vtkJPEGReader.h>
 #include <vtkImageData.h>
 #include <vtkSkybox.h>
-#include <vtkShrinkFilter.h>
-#include <vtkClipDataSet.h>
 #include <vtkPlane.h>
-#include <vtkTrivialProducer.h>
+#include <vtkTransform.h>
 
 /* Other headers */
-#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <limits>
 
 /* Note that this class inherits from the Qt class QThread which allows it to be a parallel thread
  * to the main() thread, and also from vtkCommand which allows it to act as a "callback" for the
@@ -55,9 +59,6 @@ class VRRenderThread : public QThread
 {
     Q_OBJECT
 
-    std::deque<vtkActor*> actorQueue;
-	std::deque<vtkActor*> RemoveActorQueue;
-
 public:
   
   /** 
@@ -72,9 +73,15 @@ public:
     SYNC_RENDER,
     SYNC_ACTORS,
     REMOVE_FILTERS,
-    ACTORS_CHANGED
+    ACTORS_CHANGED,
+    SWAP_INPUTS,
+    SECTIONS_CHANGED,
+    SECTION_OFFSET
   } Command;
 
+  /** @brief Normal of the section plane, SECTION_OFFSET moves it along x */
+  static constexpr double sectionNormal[3] = {-1., 0., 0.};
+
   /**  
    * @brief Constructor
    * @param parent The parent widget.
@@ -101,33 +108,112 @@ public:
     */
   void removeActor(vtkActor* actor);
 
+  /**
+   * @brief Start VR, or resume it if it is paused
+   * @brief The first call starts the thread and initialises the backend. END_RENDER only pauses VR, keeping the
+   * window, renderer and meshes on the GPU, so later calls resume within a frame or two. Call from the GUI thread only.
+   */
+  void startRendering();
+
+  /**
+   * @brief End VR completely and close the backend's window, whether it is running or paused
+   * @brief Blocks until the thread has finished. Call from the GUI thread only.
+   */
+  void shutdown();
+
+  /**
+   * @brief Check if VR is paused, i.e. the thread is waiting to be resumed with its scene intact
+   * @return true while paused
+   */
+  bool isPaused() const;
+
+  /**
+   * @brief Choose what VR is drawn to, e.g. a SimulatedVRBackend on machines with no headset
+   * @brief Only call while VR is stopped or paused, a paused session is shut down. The default is an OpenVRBackend.
+   * @param newBackend The backend, the thread takes ownership of it
+   */
+  void setBackend(VRBackend *newBackend);
+
   /**
    * @brief This allows commands to be issued to the VR thread in a thread safe way.
+   * Commands go through a lock-free queue that the VR loop drains every frame, so none are lost.
+   * They are only of use to a running VR loop and are dropped while VR is stopped, while it is paused they wait
+   * for it to resume. Call from the GUI thread only.
    * @param cmd The command to issue
    * @param value The value to pass with the command
   */
   void issueCommand(int cmd, double value = 0);
 
-  /** 
-   * @brief Applies a clip filter to the selected part
-   * @param selectedPart The part to apply the filter to
+  /**
+   * @brief Send the colour and visibility of a part to its VR actor
+   * The part is marked dirty with a copy of its values, so the VR thread never reads the part and
+   * only updates the parts that changed. Repeated syncs of one part within a frame are applied once.
+   * Call from the GUI thread only.
+   * @param part The part to sync
    */
-  void applyClipFilter(ModelPart *selectedPart);
+  void syncActor(ModelPart *part);
 
-  /** 
-   * @brief Applies a shrink filter to the selected part
-   * @param selectedPart The part to apply the filter to
+  /**
+   * @brief Get how long the oldest command of the last frame waited before it was applied
+   * @return time in nanoseconds
+   */
+  qint64 commandLatency() const;
+
+  /**
+   * @brief Show a filtered mesh on a VR actor
+   * @brief The mesh is swapped in by the VR loop between frames. Call from the GUI thread only.
+   * @param actor The VR actor of a part
+   * @param input The filtered mesh, which must not be changed afterwards
+   */
+  void setFilteredInput(vtkActor *actor, vtkSmartPointer<vtkPolyData> input);
+
+  /**
+   * @brief Clip a VR actor against the section plane while drawing, or stop clipping it
+   * @brief Only has an effect on actors the VR thread has been given. Call from the GUI thread only.
+   * @param actor The VR actor of a part
+   * @param sectioned True to clip the actor
    */
-  void applyShrinkFilter(ModelPart *selectedPart);
+  void setSectioned(vtkActor *actor, bool sectioned);
 
   /** 
    * @brief Removes all filters from the scene
+   * @brief The same as issuing REMOVE_FILTERS. Call from the GUI thread only.
    */
   void removeFilters();
 
+  /**
+   * @brief Write the timings of the most recent VR frames to a CSV file
+   * @brief Can be called while VR is running, the frames of the last session are kept once it stops
+   * @param fileName The file to write
+   * @return false if the file couldn't be written
+   */
+  bool dumpFrameStats(const QString &fileName);
+
+  /**
+   * @brief Set how long the VR loop may spend on queued changes each frame
+   * @brief Work left over when the time runs out, or when the next frame is due, waits for the next frame.
+   * At least one change of each kind is applied every frame, so queues always drain. Takes effect on the next frame.
+   * @param milliseconds Time per frame, 2 ms by default
+   */
+  void setWorkBudget(double milliseconds);
+
+  /**
+   * @brief Set how much new geometry the VR loop may hand to the GPU each frame
+   * @brief Added actors and swapped meshes are uploaded as the next frame draws, so large batches are spread
+   * over several frames. Takes effect on the next frame.
+   * @param cells Number of cells per frame, 250000 by default
+   */
+  void setUploadBudget(vtkIdType cells);
+
 signals:
 	void sendVRMessage(const QString& text);
 
+	/**
+	 * @brief Emitted about once a second while VR runs, and once more when it stops or pauses
+	 * @param summary Frame time percentiles and missed frames
+	 */
+	void frameStatsUpdated(const VRFrameSummary &summary);
+
 protected:
   /** 
    * @brief This is a re-implementation of a QThread function
@@ -135,41 +221,187 @@ protected:
   void run() override;
 
 private:
-  /** @brief Standard VTK VR Classes */
-  vtkSmartPointer<vtkOpenVRRenderWindow> window;
-  vtkSmartPointer<vtkOpenVRRenderWindowInteractor> interactor;
-  vtkSmartPointer<vtkOpenVRRenderer> renderer;
-  vtkSmartPointer<vtkOpenVRCamera> camera;
+  /**
+   * @brief Add a command to the queue, reporting it if the queue is full
+   * @param command The command to add
+   */
+  void pushCommand(const VRCommand &command);
+
+  /**
+   * @brief Mark an actor dirty with a snapshot of its part's properties (mutex must be held)
+   * @param actor The VR actor to update
+   * @param part The part it shows
+   */
+  void markDirty(vtkActor *actor, ModelPart *part);
+
+  /**
+   * @brief Take every queued command, keeping only the latest of each kind (VR thread only)
+   */
+  void drainCommands();
+
+  /** @brief How much queued work the VR loop may still do before the next frame */
+  struct FrameBudget
+  {
+    std::chrono::steady_clock::time_point deadline; /**< Work stops once this has passed */
+    vtkIdType cells;                                /**< Cells that may still be sent to the GPU this frame */
+
+    /** @brief Check if the frame's allowance is used up */
+    bool spent() const { return cells <= 0 || std::chrono::steady_clock::now() >= deadline; }
+  };
+
+  /** @brief A budget that never runs out, for work done before the first frame */
+  static FrameBudget unlimitedBudget();
+
+  /**
+   * @brief Apply every queued change regardless of budget, as a session starts (VR thread only)
+   */
+  void applyAllQueued();
+
+  /**
+   * @brief Move the queued additions and removals into the actor list (mutex must be held)
+   * @param inScene true to also add/remove them from the renderer (VR thread only)
+   * @param budget Work left this frame, what doesn't fit stays queued
+   */
+  void applyActorQueues(bool inScene, FrameBudget &budget);
+
+  /**
+   * @brief Queue a new input for a VR actor, or set it straight away while VR is stopped (mutex must be held)
+   * @param actor The VR actor
+   * @param input Its new input
+   */
+  void queueInput(vtkActor *actor, vtkSmartPointer<vtkPolyData> input);
+
+  /**
+   * @brief Swap the queued inputs into the VR actors' mappers (VR thread only)
+   * @param budget Work left this frame, what doesn't fit stays queued
+   */
+  void applyInputs(FrameBudget &budget);
+
+  /**
+   * @brief Add or remove the section plane on the queued actors' mappers (mutex must be held)
+   * @param actor The VR actor
+   * @param sectioned True to clip it
+   */
+  void setSectionPlane(vtkActor *actor, bool sectioned);
+
+  /**
+   * @brief Move the section plane to sectionOffset in the scene's coordinates, after the scene or the offset changes
+   * @brief VR thread only while it runs
+   */
+  void placeSectionPlane();
+
+  /**
+   * @brief Apply the queued section changes (VR thread only)
+   * @param budget Work left this frame, what doesn't fit stays queued
+   */
+  void applySections(FrameBudget &budget);
+
+  /**
+   * @brief Apply the snapshots of the dirty actors (VR thread only)
+   * @param budget Work left this frame, what doesn't fit stays queued
+   */
+  void applyActorSyncs(FrameBudget &budget);
+
+  /** @brief The headset, or a stand-in for it, that owns the window and camera */
+  std::unique_ptr<VRBackend> backend;
+
+  /** @brief The backend's renderer while VR is running, null otherwise */
+  vtkSmartPointer<vtkRenderer> renderer;
 
   /** @brief Use to synchronise passing of data to VR thread */
   QMutex mutex;
   QWaitCondition condition;
 
-  /** @brief List of actors that will need to be added to the VR scene */
-  vtkSmartPointer<vtkActorCollection> actors;
+  /** @brief Actors in the VR scene, keyed by pointer so membership checks are constant time.
+   * The smart pointer keeps each actor alive while it is in the scene
+   */
+  std::unordered_map<vtkActor *, vtkSmartPointer<vtkActor>> actors;
+
+  /** @brief Actors queued by the GUI while VR is running, applied by the VR thread */
+  std::unordered_map<vtkActor *, vtkSmartPointer<vtkActor>> actorsToAdd;
+  std::unordered_set<vtkActor *> actorsToRemove;
 
-  /** @brief A timer to help implement animations and visual effects */
+  /** @brief A timer to help implement animations and visual effects, the time of the last animation step */
   std::chrono::time_point<std::chrono::steady_clock> t_last;
 
-  /** @brief This will be set to false by the constructor, if it is set to true
-   * by the GUI then the rendering will end
+  /** @brief Commands from the GUI thread, drained by the VR loop */
+  VRCommandQueue commands;
+
+  /** @brief Set once a full queue has been reported, GUI thread only */
+  bool queueFullReported;
+
+  /** @brief Input waiting to be swapped into each VR actor's mapper, guarded by the mutex */
+  std::unordered_map<vtkActor *, vtkSmartPointer<vtkPolyData>> pendingInputs;
+
+  /** @brief Actors that should be clipped by the section plane, guarded by the mutex */
+  std::unordered_set<vtkActor *> sectionedActors;
+
+  /** @brief Section changes waiting for the VR loop, guarded by the mutex */
+  std::unordered_map<vtkActor *, bool> pendingSections;
+
+  /** @brief Rotation of the whole VR scene, every actor in it uses it as its user transform.
+   * Only changed by the VR thread while it runs, each actor recomputes its matrix when it next draws
    */
-  bool endRender;
+  vtkSmartPointer<vtkTransform> sceneTransform;
+
+  /** @brief Section plane of the VR mappers, only moved by the VR thread while it runs */
+  vtkSmartPointer<vtkPlane> sectionPlane;
+
+  /** @brief Where SECTION_OFFSET put the section plane along x, before the scene is turned */
+  double sectionOffset;
+
+  /** @brief Properties of a part as they should appear in VR */
+  struct VRActorState
+  {
+    QRgb colour;  /**< Colour packed as 0xAARRGGBB */
+    bool visible; /**< Visibility */
+  };
+
+  /** @brief Latest snapshot of each actor changed since the VR loop last looked, guarded by the mutex */
+  std::unordered_map<vtkActor *, VRActorState> dirtyActors;
+
+  /** @brief Timings of the recent frames, written by the VR loop */
+  VRFrameStats frameStats;
+
+  /** @brief Time per frame for queued changes in nanoseconds, see setWorkBudget() */
+  std::atomic<qint64> workBudget;
+
+  /** @brief Cells per frame for new geometry, see setUploadBudget() */
+  std::atomic<vtkIdType> uploadBudget;
+
+  /** @brief Set by shutdown() to end the thread rather than pause it, written under the mutex */
+  std::atomic<bool> quitRequested;
+
+  /** @brief Set by END_RENDER to pause VR, cleared by startRendering(), written under the mutex */
+  std::atomic<bool> endRender;
+
+  /** @brief Value returned by isPaused() */
+  std::atomic<bool> paused;
+
+  /** @brief When the last resume was asked for, guarded by the mutex */
+  qint64 resumeIssued;
+
+  /** @brief Value returned by commandLatency() */
+  std::atomic<qint64> lastCommandLatency;
+
+  /* The variables below are only touched by the VR thread, the GUI changes them through commands */
 
   /** @brief Some variables to indicate animation actions to apply. */
   double rotateX; /*< Degrees to rotate around X axis (per time-step) */
   double rotateY; /*< Degrees to rotate around Y axis (per time-step) */
   double rotateZ; /*< Degrees to rotate around Z axis (per time-step) */
 
-  /** @brief When set high calls the sync render section */
-  bool syncRender;
-  /** @brief When set high removes the filters from the scene */
-  bool removeFiltersFlag;
+  /** @brief When set high swaps in the pending inputs */
+  bool inputsPending;
+  /** @brief When set high applies the pending section changes */
+  bool sectionsPending;
   /** @brief When set high calls the changed actors section */
   bool actorsChanged;
+  /** @brief When set high applies the dirty actors */
+  bool actorsDirty;
 
   /** @brief A map to link actors to model parts */
-  std::map<vtkActor *, ModelPart *> actorMap;
+  std::unordered_map<vtkActor *, ModelPart *> actorMap;
 };
 
 #endif
\ No newline at end of file
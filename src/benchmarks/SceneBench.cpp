@@ -0,0 +1,116 @@
+/**     @file SceneBench.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief Measures how long one edit of the tree takes to reach the scene
+ *
+ *     Usage: SceneBench [parts], 10000 parts by default. Each kind of edit is made 1000 times on random parts
+ *     and the time from the model call returning to the scene being up to date is reported. The render that
+ *     follows is left out, it is the same whichever way the scene was updated.
+ */
+
+#include "../ModelPartList.h"
+#include "../ModelPart.h"
+#include "../RenderScene.h"
+#include "../VRRenderThread.h"
+
+#include <QCoreApplication>
+#include <QColor>
+
+#include <vtkNew.h>
+#include <vtkRenderer.h>
+#include <vtkSphereSource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace
+{
+    /* Time each call of edit in microseconds and print the mean, 99th percentile and worst */
+    void report(const char *name, int count, const std::function<void(int)> &edit)
+    {
+        std::vector<double> times;
+        times.reserve(std::size_t(count));
+        for (int i = 0; i < count; i++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            edit(i);
+            times.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        double total = 0.;
+        for (double t : times)
+            total += t;
+        std::sort(times.begin(), times.end());
+        std::printf("%-18s %12.1f %12.1f %12.1f\n", name, total / count, times[std::size_t(0.99 * (count - 1))], times.back());
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    int partCount = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10000;
+
+    ModelPartList model("Parts List");
+    vtkNew<vtkRenderer> renderer;
+
+    /* VR is never started, so the VR actors are updated straight away rather than queued */
+    VRRenderThread vrThread;
+    RenderScene scene(&model, renderer, &vrThread);
+
+    /* Every part draws the same small mesh, like a folder of identical files */
+    vtkNew<vtkSphereSource> sphere;
+    sphere->Update();
+    PartMesh mesh;
+    mesh.polyData = sphere->GetOutput();
+    mesh.key.contentHash = 1;
+    mesh.key.fileSize = 1;
+
+    QModelIndex folder = model.appendChild(QModelIndex(), {QString("folder")});
+    static_cast<ModelPart *>(folder.internalPointer())->setFolder();
+
+    QList<QList<QVariant>> rows;
+    for (int i = 0; i < partCount; i++)
+        rows.append({QString("part%1.stl").arg(i), QString("true"), QColor(255, 255, 255)});
+    for (ModelPart *part : model.appendChildren(folder, rows))
+    {
+        part->setMesh(mesh);
+        model.updateActor(part);
+    }
+
+    std::printf("%d parts\n%-18s %12s %12s %12s\n", partCount, "edit", "mean us", "p99 us", "max us");
+
+    std::mt19937 random(1);
+    auto randomRow = [&]() { return int(random() % unsigned(model.rowCount(folder))); };
+
+    report("toggle visibility", 1000, [&](int) {
+        QModelIndex index = model.index(randomRow(), 1, folder);
+        model.setData(index, !index.data().toBool(), Qt::EditRole);
+    });
+
+    report("change colour", 1000, [&](int i) {
+        model.setData(model.index(randomRow(), 2, folder), QColor::fromHsv(i % 360, 200, 200), Qt::EditRole);
+    });
+
+    report("add part", 1000, [&](int i) {
+        QModelIndex index = model.appendChild(folder, {QString("added%1.stl").arg(i), QString("true"), QColor(255, 255, 255)});
+        ModelPart *part = static_cast<ModelPart *>(index.internalPointer());
+        part->setMesh(mesh);
+        model.updateActor(part);
+    });
+
+    report("remove part", 1000, [&](int) {
+        model.removeRow(randomRow(), folder);
+    });
+
+    /* What every edit cost when the whole scene was rebuilt */
+    report("full rebuild", 10, [&](int) {
+        scene.rebuild();
+    });
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+/**     @file TreeBench.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief Measures the memory and traversal time of the model tree's node store
+ *
+ *     Run with no arguments, prints one line per tree size and then one line per folder size.
+ */
+
+#include "../ModelPartStore.h"
+
+#include <QRgb>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+    typedef ModelPartStore::NodeId NodeId;
+
+    /* Milliseconds since start */
+    double since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /* A root holding folders of folderSize parts, like a folder import */
+    NodeId buildTree(ModelPartStore &store, int nodes, int folderSize)
+    {
+        NodeId root = store.create(QString("Parts List"), ModelPartStore::NameOnly, qRgb(255, 255, 255), nullptr);
+        NodeId folder = ModelPartStore::NoNode;
+        for (int i = 0; i < nodes; i++)
+        {
+            if (i % folderSize == 0)
+            {
+                folder = store.create(QString("folder") + QString::number(i / folderSize),
+                                      ModelPartStore::Folder | ModelPartStore::NameOnly, qRgb(255, 255, 255), nullptr);
+                store.appendChild(root, folder);
+            }
+            NodeId part = store.create(QString("part") + QString::number(i) + QString(".stl"),
+                                       ModelPartStore::Visible, qRgb(200, 200, 200), nullptr);
+            store.appendChild(folder, part);
+        }
+        return root;
+    }
+
+    /* Visit every node depth first the way the tree view does, through child(row) */
+    int countVisible(const ModelPartStore &store, NodeId node)
+    {
+        int visible = store.testFlag(node, ModelPartStore::Visible) ? 1 : 0;
+        int rows = store.childCount(node);
+        for (int row = 0; row < rows; row++)
+            visible += countVisible(store, store.child(node, row));
+        return visible;
+    }
+
+    /* Free a folder's children the way ~ModelPart does, last child first */
+    void closeFolder(ModelPartStore &store, NodeId folder)
+    {
+        NodeId child;
+        while ((child = store.lastChild(folder)) != ModelPartStore::NoNode)
+        {
+            store.detach(child);
+            store.destroy(child);
+        }
+    }
+}
+
+int main()
+{
+    std::printf("%10s %12s %12s %14s %16s\n", "nodes", "build ms", "bytes/node", "traversal ms", "random child ns");
+
+    for (int nodes : {100000, 1000000})
+    {
+        ModelPartStore store;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        NodeId root = buildTree(store, nodes, 1000);
+        double build = since(start);
+
+        double bytesPerNode = double(store.memoryUsage()) / store.nodeCount();
+
+        start = std::chrono::steady_clock::now();
+        int visible = countVisible(store, root);
+        double traversal = since(start);
+
+        /* Random rows of random folders, like dragging the scroll bar */
+        std::mt19937 random(1);
+        const int lookups = 1000000;
+        NodeId sum = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < lookups; i++)
+        {
+            NodeId folder = store.child(root, int(random() % unsigned(store.childCount(root))));
+            sum += store.child(folder, int(random() % unsigned(store.childCount(folder))));
+        }
+        double lookup = since(start) * 1e6 / lookups;
+
+        std::printf("%10d %12.1f %12.1f %14.2f %16.1f\n", nodes, build, bytesPerNode, traversal, lookup);
+
+        /* Keep the results live so the loops aren't optimised away */
+        if (visible != nodes || sum == 0)
+            std::printf("unexpected result\n");
+    }
+
+    /* What the tree view asks for as a single folder grows: scrolling looks up index(row) for random rows
+     * and parent() (the row of the parent) for each, expanding asks for the first screenful of rows
+     */
+    std::printf("\n%10s %18s %18s %12s\n", "folder", "scroll ns/row", "expand us", "close ms");
+
+    for (int folderSize : {1000, 10000, 100000})
+    {
+        ModelPartStore store;
+        NodeId root = buildTree(store, folderSize, folderSize);
+        NodeId folder = store.child(root, 0);
+
+        std::mt19937 random(1);
+        const int lookups = 1000000;
+        qint64 sum = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < lookups; i++)
+        {
+            NodeId part = store.child(folder, int(random() % unsigned(folderSize)));
+            sum += store.row(store.parent(part)) + store.row(part);
+        }
+        double scroll = since(start) * 1e6 / lookups;
+
+        const int expands = 10000;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < expands; i++)
+        {
+            int rows = store.childCount(folder);
+            for (int row = 0; row < 50 && row < rows; row++)
+                sum += store.row(store.child(folder, row));
+        }
+        double expand = since(start) * 1e3 / expands;
+
+        start = std::chrono::steady_clock::now();
+        closeFolder(store, folder);
+        double close = since(start);
+
+        std::printf("%10d %18.1f %18.3f %12.2f\n", folderSize, scroll, expand, close);
+
+        if (sum < 0)
+            std::printf("unexpected result\n");
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+/**     @file VRBench.cpp
+ *
+ *     EEEE2076 - Software Engineering & VR Project
+ *
+ *     @brief Runs the VR loop headless for a fixed number of frames and reports its frame times
+ *
+ *     Usage: VRBench [frames] [parts] [csv] [fly], 2000 frames of 1000 parts written to vr_frames.csv by
+ *     default. The frames go through the same render thread, command queue and actor management as a headset,
+ *     drawn offscreen by a SimulatedVRBackend. While VR runs a part's visibility is toggled every 10 ms, so
+ *     the timings include applying edits. With "fly" the head passes through the middle of the scene rather
+ *     than circling it, so most of the parts fill the view at some point.
+ */
+
+#include "../ModelPartList.h"
+#include "../ModelPart.h"
+#include "../RenderScene.h"
+#include "../SimulatedVRBackend.h"
+#include "../VRRenderThread.h"
+
+#include <QCoreApplication>
+#include <QColor>
+
+#include <vtkNew.h>
+#include <vtkRenderer.h>
+#include <vtkSphereSource.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace
+{
+    /* Fly from one side of the scene to the other and back every 10 s, looking ahead */
+    HeadPose flyThrough(double seconds, const double bounds[6])
+    {
+        HeadPose pose;
+        double centre[3];
+        double size = 0.;
+        for (int i = 0; i < 3; i++)
+        {
+            centre[i] = (bounds[2 * i] + bounds[2 * i + 1]) / 2.;
+            size = std::max(size, bounds[2 * i + 1] - bounds[2 * i]);
+        }
+        if (size <= 0.)
+            size = 1.;
+
+        double phase = std::fmod(seconds / 10., 1.);
+        double direction = phase < 0.5 ? -1. : 1.;
+        double along = size * (phase < 0.5 ? 1. - 4. * phase : 4. * phase - 3.);
+        for (int i = 0; i < 3; i++)
+        {
+            pose.position[i] = centre[i];
+            pose.focalPoint[i] = centre[i];
+        }
+        pose.position[2] += along;
+        pose.focalPoint[2] += along + direction * size;
+        return pose;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    long frameCount = argc > 1 ? std::max(1L, std::atol(argv[1])) : 2000;
+    int partCount = argc > 2 ? std::max(1, std::atoi(argv[2])) : 1000;
+    QString csvName = argc > 3 ? QString(argv[3]) : QString("vr_frames.csv");
+    bool fly = argc > 4 && std::strcmp(argv[4], "fly") == 0;
+
+    ModelPartList model("Parts List");
+    vtkNew<vtkRenderer> renderer;
+    VRRenderThread vrThread;
+    RenderScene scene(&model, renderer, &vrThread);
+
+    /* There is no event loop, so the VR thread's signals are handled on it as they are emitted */
+    QObject::connect(&vrThread, &VRRenderThread::sendVRMessage, [](const QString &text) {
+        std::printf("%s\n", qPrintable(text));
+    }, Qt::DirectConnection);
+
+    VRFrameSummary last;
+    QObject::connect(&vrThread, &VRRenderThread::frameStatsUpdated, [&last](const VRFrameSummary &summary) {
+        std::printf("%6d frames  p50 %6.2f  p95 %6.2f  p99 %6.2f ms  missed %lld\n", summary.frames,
+                    summary.p50, summary.p95, summary.p99, static_cast<long long>(summary.missed));
+        last = summary;
+    }, Qt::DirectConnection);
+
+    /* Every part draws the same small mesh, laid out on a grid so they cover the view */
+    vtkNew<vtkSphereSource> sphere;
+    sphere->SetThetaResolution(32);
+    sphere->SetPhiResolution(32);
+    sphere->Update();
+    PartMesh mesh;
+    mesh.polyData = sphere->GetOutput();
+    mesh.key.contentHash = 1;
+    mesh.key.fileSize = 1;
+
+    QModelIndex folder = model.appendChild(QModelIndex(), {QString("folder")});
+    static_cast<ModelPart *>(folder.internalPointer())->setFolder();
+
+    QList<QList<QVariant>> rows;
+    for (int i = 0; i < partCount; i++)
+        rows.append({QString("part%1.stl").arg(i), QString("true"), QColor::fromHsv(i % 360, 200, 200)});
+
+    int side = int(std::ceil(std::cbrt(double(partCount))));
+    int i = 0;
+    for (ModelPart *part : model.appendChildren(folder, rows))
+    {
+        part->setMesh(mesh);
+        model.updateActor(part);
+        double position[3] = {2. * (i % side), 2. * (i / side % side), 2. * (i / (side * side))};
+        part->getActor()->SetPosition(position);
+        part->getVRActor()->SetPosition(position);
+        i++;
+    }
+
+    SimulatedVRBackend *backend = new SimulatedVRBackend();
+    backend->setFrameLimit(frameCount);
+    if (fly)
+        backend->setPoseScript(flyThrough);
+    vrThread.setBackend(backend);
+
+    std::printf("%ld frames of %d parts%s\n", frameCount, partCount, fly ? ", flying through" : "");
+    vrThread.startRendering();
+
+    /* The thread ends by itself once the backend has drawn its frames */
+    std::mt19937 random(1);
+    while (!vrThread.wait(10))
+    {
+        QModelIndex index = model.index(int(random() % unsigned(model.rowCount(folder))), 1, folder);
+        model.setData(index, !index.data().toBool(), Qt::EditRole);
+    }
+
+    std::printf("overall  p50 %6.2f  p95 %6.2f  p99 %6.2f ms  budget %.2f ms  missed %lld\n", last.p50, last.p95,
+                last.p99, last.budget, static_cast<long long>(last.missedTotal));
+
+    if (!vrThread.dumpFrameStats(csvName))
+    {
+        std::fprintf(stderr, "Couldn't write %s\n", qPrintable(csvName));
+        return 1;
+    }
+    std::printf("Frame timings written to %s\n", qPrintable(csvName));
+    return 0;
+}
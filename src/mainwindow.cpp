@@ -7,18 +7,45 @@
 
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
+#include "GeometryCache.h"
+#include "FilterCache.h"
+#include "MeshDiskCache.h"
+#include "OpenVRBackend.h"
+#include "SimulatedVRBackend.h"
+
+#include <QInputDialog>
+#include <QSettings>
+
+namespace
+{
+    /* Where the settings chosen in the menus are kept between runs */
+    QSettings appSettings()
+    {
+        return QSettings("EEEE2076", "VRBaseStation");
+    }
+
+    /* VRRenderThread's own defaults, used until the budget is changed from the VR menu */
+    const double defaultWorkBudget = 2.;
+    const qint64 defaultUploadBudget = 250000;
+}
 
 // Constructors Destructors etc
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), ui(new Ui::MainWindow)
+    : QMainWindow(parent), ui(new Ui::MainWindow), frameStatsLabel(nullptr), importProgress(nullptr)
 {
     ui->setupUi(this);
     ui->treeView = findChild<NewTreeView *>("treeView");
     /* add dropdown menu actions */
     ui->treeView->addAction(ui->actionItem_Options);
     ui->treeView->addAction(ui->actionDelete_Item);
+    ui->treeView->addAction(ui->actionSection_View);
     ui->treeView->addAction(ui->actionClip_Filter);
     ui->treeView->addAction(ui->actionShrink_Filter);
+    ui->treeView->addAction(ui->actionDecimate_Filter);
+    ui->treeView->addAction(ui->actionSmooth_Filter);
+    ui->treeView->addAction(ui->actionEdit_Filter);
+    ui->treeView->addAction(ui->actionRemove_Last_Filter);
+    ui->treeView->addAction(ui->actionClear_Filters);
 
     /* connections */
     connect(this, &MainWindow::statusUpdateMessage, ui->statusbar, &QStatusBar::showMessage);
@@ -31,12 +58,27 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->actionStop_VR, &QAction::triggered, this, &MainWindow::on_actionStop_VR_triggered);
     connect(ui->actionClip_Filter, &QAction::triggered, this, &MainWindow::on_actionClip_Filter_triggered);
     connect(ui->actionShrink_Filter, &QAction::triggered, this, &MainWindow::on_actionShrink_Filter_triggered);
+    connect(ui->actionLoad_On_Demand, &QAction::toggled, this, &MainWindow::handleLoadOnDemandToggled);
+    connect(ui->actionMesh_Cache_Folder, &QAction::triggered, this, &MainWindow::handleMeshCacheFolder);
+    connect(ui->actionMesh_Cache_Size, &QAction::triggered, this, &MainWindow::handleMeshCacheSize);
+    connect(ui->actionReset_Camera, &QAction::triggered, this, &MainWindow::handleResetCamera);
+    connect(ui->actionSimulate_Headset, &QAction::toggled, this, &MainWindow::handleSimulateHeadsetToggled);
+    connect(ui->actionSave_Frame_Timings, &QAction::triggered, this, &MainWindow::handleSaveFrameTimings);
+    connect(ui->actionVR_Frame_Budget, &QAction::triggered, this, &MainWindow::handleVRFrameBudget);
+    connect(ui->actionSection_View, &QAction::triggered, this, &MainWindow::handleSectionView);
+    connect(ui->sectionSlider, &QSlider::valueChanged, this, &MainWindow::handleSectionMoved);
+    connect(ui->actionDecimate_Filter, &QAction::triggered, this, &MainWindow::handleDecimateFilter);
+    connect(ui->actionSmooth_Filter, &QAction::triggered, this, &MainWindow::handleSmoothFilter);
+    connect(ui->actionEdit_Filter, &QAction::triggered, this, &MainWindow::handleEditFilter);
+    connect(ui->actionRemove_Last_Filter, &QAction::triggered, this, &MainWindow::handleRemoveLastFilter);
+    connect(ui->actionClear_Filters, &QAction::triggered, this, &MainWindow::handleClearFilters);
 
     /* Create/allocate the ModelList */
     this->partList = new ModelPartList("Parts List");
 
     /* Link it to the tree view in the GUI */
     ui->treeView->setModel(this->partList);
+    connect(ui->treeView->selectionModel(), &QItemSelectionModel::currentChanged, this, &MainWindow::handleCurrentChanged);
 
     /* Link a render window with the Qt widget */
     renderWindow = vtkSmartPointer<vtkGenericOpenGLRenderWindow>::New();
@@ -100,7 +142,48 @@ MainWindow::MainWindow(QWidget *parent)
     renderer->AddLight(light);
 
     vrThread = new VRRenderThread();
+
+    /* Keep the renderers in step with the tree */
+    scene = new RenderScene(partList, renderer, vrThread, this);
+    connect(scene, &RenderScene::loadRequested, this, &MainWindow::requestPartLoad);
 	connect(vrThread, &VRRenderThread::sendVRMessage, this, &MainWindow::handleVRMessage);
+    connect(vrThread, &VRRenderThread::frameStatsUpdated, this, &MainWindow::handleFrameStats);
+
+    /* Frame times stay visible while other messages come and go */
+    frameStatsLabel = new QLabel(this);
+    ui->statusbar->addPermanentWidget(frameStatsLabel);
+
+    /* Background loader for folders of STL files */
+    importer = new STLImporter(this);
+    connect(importer, &STLImporter::partLoaded, this, &MainWindow::handleImportedPart);
+    connect(importer, &STLImporter::loadFailed, this, &MainWindow::handleImportFailed);
+    connect(importer, &STLImporter::progressChanged, this, &MainWindow::handleImportProgress);
+    connect(importer, &STLImporter::finished, this, &MainWindow::handleImportFinished);
+    connect(importer, &STLImporter::headerLoaded, this, &MainWindow::handleImportedHeader);
+    connect(importer, &STLImporter::partLoadedOnDemand, this, &MainWindow::handleOnDemandPart);
+
+    /* Imported parts are added to the tree at most this often */
+    importFlushTimer = new QTimer(this);
+    importFlushTimer->setSingleShot(true);
+    importFlushTimer->setInterval(100);
+    connect(importFlushTimer, &QTimer::timeout, this, &MainWindow::flushImportedParts);
+
+    /* Background workers for the filters */
+    filterRunner = new FilterRunner(this);
+    connect(filterRunner, &FilterRunner::filterFinished, this, &MainWindow::handleFilterFinished);
+    connect(filterRunner, &FilterRunner::progressChanged, this, &MainWindow::handleFilterProgress);
+
+    /* Mesh cache settings from the last run, the cache's own defaults otherwise */
+    QSettings settings = appSettings();
+    if (settings.contains("meshCache/directory"))
+        MeshDiskCache::instance().setDirectory(settings.value("meshCache/directory").toString());
+    if (settings.contains("meshCache/maxSize"))
+        MeshDiskCache::instance().setMaxSize(settings.value("meshCache/maxSize").toLongLong());
+
+    /* Likewise the VR frame budget */
+    vrThread->setWorkBudget(settings.value("vr/workBudget", defaultWorkBudget).toDouble());
+    vrThread->setUploadBudget(settings.value("vr/uploadBudget", defaultUploadBudget).toLongLong());
+
     /*
     // Create a skybox ------------------------------------------------------------------
     vtkSmartPointer<vtkTexture> texture = vtkSmartPointer<vtkTexture>::New();
@@ -135,6 +218,13 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    /* Stop the import workers before the tree they feed is deleted */
+    disconnect(importer, nullptr, this, nullptr);
+    delete importer;
+
+    /* Likewise for the filter workers, their results go to the VR thread */
+    delete filterRunner;
+
     delete ui;
     delete partList;
     delete vrThread;
@@ -151,6 +241,9 @@ void MainWindow::handleButton1()
 
 void MainWindow::handleButton2()
 {
+    /* Filters still running would put themselves back on afterwards */
+    filterRunner->cancelAll();
+    clearAllFilters(partList->getRootItem());
     vrThread->issueCommand(VRRenderThread::REMOVE_FILTERS);
     emit statusUpdateMessage(QString("Filters removed"), 0);
 }
@@ -195,12 +288,7 @@ void MainWindow::on_actionDelete_Item_triggered()
         return;
     }
 
-	vrThread->removeActor(selectedPart->getVRActor());
-    
-    /* Remove the actor from the map */
-    actorToModelPart.erase(selectedPart->getActor());
-
-    /* Delete the selected item */
+    /* Delete the selected item, the scene takes its actors out as the row goes */
     QModelIndex parentIndex = index.parent();
     int row = index.row();
     if (partList->removeRow(row, parentIndex))
@@ -214,12 +302,6 @@ void MainWindow::on_actionDelete_Item_triggered()
 
     /* Reconnect the action's signal */
     connect(ui->actionDelete_Item, &QAction::triggered, this, &MainWindow::on_actionDelete_Item_triggered);
-
-    /* Update the tree view */
-    partList->dataChanged(parentIndex, parentIndex);
-
-    /* Update the render window */
-    updateRender();
 }
 
 // -----------------------------------------------------------------------------------------------
@@ -245,13 +327,17 @@ void MainWindow::on_actionOpen_File_triggered()
     QModelIndex index;
     openFile(filePath, index);
 
-    updateRender();
-
     emit statusUpdateMessage(QString("File Opened: ") + filePath, 0);
 }
 
 void MainWindow::on_actionOpen_Folder_triggered()
 {
+    if (importer->isBusy())
+    {
+        emit statusUpdateMessage(QString("A folder is already being opened"), 0);
+        return;
+    }
+
     emit statusUpdateMessage(QString("Opening Folder"), 0);
 
     /* Open a directory dialog */
@@ -272,10 +358,6 @@ void MainWindow::on_actionOpen_Folder_triggered()
                                                                  << "*.STL",
                                                    QDir::Files);
 
-        /* Create a QProgressDialog */
-        QProgressDialog progress("Loading Files...", "Cancel", 0, stlFiles.size(), this);
-        progress.setWindowModality(Qt::WindowModal);
-
         QModelIndex parentIndex;
         if (ui->treeView->selectionModel()->hasSelection())
         {
@@ -288,22 +370,22 @@ void MainWindow::on_actionOpen_Folder_triggered()
         /* Set the folder flag */
         static_cast<ModelPart *>(folderIndex.internalPointer())->setFolder();
 
-        int i = 0;
+        /* Parts are added to this folder as the importer finishes them */
+        importFolder = QPersistentModelIndex(folderIndex);
+
+        /* Create a QProgressDialog - the files load in the background so this doesn't block */
+        importProgress = new QProgressDialog("Loading Files...", "Cancel", 0, stlFiles.size(), this);
+        importProgress->setWindowModality(Qt::WindowModal);
+        importProgress->setMinimumDuration(0);
+        importProgress->setValue(0);
+        connect(importProgress, &QProgressDialog::canceled, importer, &STLImporter::cancel);
+
+        QStringList filePaths;
         foreach (QString fileName, stlFiles)
         {
-            /* Update the progress dialog */
-            progress.setValue(i++);
-            if (progress.wasCanceled())
-                break;
-            emit statusUpdateMessage(QString("File Opened: ") + fileName, 0);
-            openFile(dirName + "/" + fileName, folderIndex);
+            filePaths << directory.filePath(fileName);
         }
-        progress.setValue(stlFiles.size());
-
-        /* Update the tree view */
-        partList->dataChanged(QModelIndex(), QModelIndex());
-
-        updateRender();
+        importer->importFiles(filePaths);
     }
     /* If no directory was selected */
     else
@@ -312,6 +394,243 @@ void MainWindow::on_actionOpen_Folder_triggered()
     }
 }
 
+void MainWindow::handleImportedPart(const QString &filePath, const PartMesh &mesh)
+{
+    /* Parts are added to the tree in batches, so a folder of thousands of files
+     * doesn't mean thousands of separate row insertions */
+    importedParts.append(qMakePair(filePath, mesh));
+    if (!importFlushTimer->isActive())
+        importFlushTimer->start();
+}
+
+void MainWindow::handleImportedHeader(const QString &filePath, const PartHeader &header)
+{
+    importedHeaders.append(qMakePair(filePath, header));
+    if (!importFlushTimer->isActive())
+        importFlushTimer->start();
+}
+
+void MainWindow::flushImportedParts()
+{
+    importFlushTimer->stop();
+    if (importedParts.isEmpty() && importedHeaders.isEmpty())
+        return;
+
+    /* Give up if the folder was deleted while its files were loading */
+    if (!importFolder.isValid())
+    {
+        discardImportedParts();
+        importer->cancel();
+        return;
+    }
+
+    QModelIndex folderIndex(importFolder);
+
+    if (!importedParts.isEmpty())
+    {
+        /* Add the parts to the folder in one go */
+        QList<QList<QVariant>> itemData;
+        itemData.reserve(importedParts.size());
+        for (const QPair<QString, PartMesh> &imported : importedParts)
+            itemData.append({QFileInfo(imported.first).fileName(), QString("true"), QColor(255, 255, 255)});
+
+        QList<ModelPart *> newItems = partList->appendChildren(folderIndex, itemData);
+
+        for (int i = 0; i < newItems.size(); i++)
+        {
+            ModelPart *newItem = newItems[i];
+
+            /* Attach the geometry that was read on the worker thread, the scene adds the new actors */
+            newItem->setMesh(importedParts[i].second);
+            partList->updateActor(newItem);
+        }
+
+        const PartMesh &mesh = importedParts.last().second;
+        emit statusUpdateMessage(QString("File Opened: %1 (%2 vertices welded to %3)")
+                                     .arg(newItems.last()->name())
+                                     .arg(mesh.vertexCountBeforeWeld)
+                                     .arg(mesh.vertexCountAfterWeld),
+                                 0);
+        importedParts.clear();
+    }
+
+    if (!importedHeaders.isEmpty())
+    {
+        /* Add the placeholders to the folder, hidden until they are loaded */
+        QList<QList<QVariant>> itemData;
+        itemData.reserve(importedHeaders.size());
+        for (const QPair<QString, PartHeader> &imported : importedHeaders)
+            itemData.append({QFileInfo(imported.first).fileName(), QString("false"), QColor(255, 255, 255)});
+
+        QList<ModelPart *> newItems = partList->appendChildren(folderIndex, itemData);
+
+        for (int i = 0; i < newItems.size(); i++)
+        {
+            ModelPart *newItem = newItems[i];
+
+            /* Show a box where the part will be until it is loaded */
+            newItem->setPlaceholder(importedHeaders[i].first, importedHeaders[i].second);
+            partList->updateActor(newItem);
+        }
+        importedHeaders.clear();
+    }
+}
+
+void MainWindow::discardImportedParts()
+{
+    importFlushTimer->stop();
+
+    QList<QPair<QString, PartMesh>> discarded;
+    discarded.swap(importedParts);
+    importedHeaders.clear();
+
+    /* No part claimed these meshes, so the cache would keep them for nothing */
+    for (const QPair<QString, PartMesh> &imported : discarded)
+        GeometryCache::instance().dropUnused(imported.second.key);
+}
+
+void MainWindow::handleOnDemandPart(const QString &filePath, const PartMesh &mesh)
+{
+    QList<QPersistentModelIndex> waiting = pendingLoads.values(filePath);
+    pendingLoads.remove(filePath);
+
+    bool used = false;
+    for (const QPersistentModelIndex &persistentIndex : waiting)
+    {
+        /* The part may have been deleted while it was loading */
+        if (!persistentIndex.isValid())
+            continue;
+
+        QModelIndex index(persistentIndex);
+        ModelPart *part = static_cast<ModelPart *>(index.internalPointer());
+        part->setLoading(false);
+
+        if (mesh.polyData == nullptr)
+        {
+            emit statusUpdateMessage(QString("Unable to open file: ") + filePath, 0);
+            partList->dataChanged(index, index);
+            continue;
+        }
+
+        /* Swap the placeholder box for the real actor, the scene takes the box out. Placeholders start
+         * hidden, so the part is shown as well or it would vanish when it loads
+         */
+        part->setMesh(mesh);
+        used = true;
+
+        partList->setData(index.siblingAtColumn(1), true, Qt::EditRole);
+        partList->updateActor(part);
+
+        emit statusUpdateMessage(QString("File Loaded: %1 (%2 vertices welded to %3)")
+                                     .arg(part->name())
+                                     .arg(mesh.vertexCountBeforeWeld)
+                                     .arg(mesh.vertexCountAfterWeld),
+                                 0);
+    }
+
+    /* Don't keep the mesh around if every part that wanted it has gone */
+    if (!used)
+        GeometryCache::instance().dropUnused(mesh.key);
+}
+
+void MainWindow::requestPartLoad(const QModelIndex &index)
+{
+    ModelPart *part = static_cast<ModelPart *>(index.internalPointer());
+    if (!part || part->isFolder() || part->isResident() || part->isLoading() || part->filePath().isEmpty())
+        return;
+
+    part->setLoading(true);
+    pendingLoads.insert(part->filePath(), QPersistentModelIndex(index));
+    importer->loadPart(part->filePath());
+
+    /* Update the tree view */
+    partList->dataChanged(index, index);
+
+    emit statusUpdateMessage(QString("Loading: ") + part->name(), 0);
+}
+
+void MainWindow::handleCurrentChanged(const QModelIndex &current)
+{
+    /* Selecting a placeholder (in the tree or by clicking its box) loads it */
+    if (current.isValid())
+        requestPartLoad(current.siblingAtColumn(0));
+}
+
+void MainWindow::handleLoadOnDemandToggled(bool checked)
+{
+    importer->setLazy(checked);
+
+    if (checked)
+        emit statusUpdateMessage(QString("Folders will load parts when they are selected or shown"), 0);
+    else
+        emit statusUpdateMessage(QString("Folders will load all parts"), 0);
+}
+
+void MainWindow::handleMeshCacheFolder()
+{
+    QString dir = QFileDialog::getExistingDirectory(this, tr("Mesh Cache Folder"), MeshDiskCache::instance().directory());
+    if (dir.isEmpty())
+        return;
+
+    MeshDiskCache::instance().setDirectory(dir);
+    appSettings().setValue("meshCache/directory", dir);
+    emit statusUpdateMessage(QString("Meshes will be cached in ") + dir, 0);
+}
+
+void MainWindow::handleMeshCacheSize()
+{
+    const qint64 megabyte = qint64(1) << 20;
+
+    bool ok = false;
+    int size = QInputDialog::getInt(this, tr("Mesh Cache Size"), tr("Maximum size (MB):"),
+                                    int(MeshDiskCache::instance().maxSize() / megabyte), 16, 1 << 20, 256, &ok);
+    if (!ok)
+        return;
+
+    /* Takes effect the next time a mesh is cached, which evicts down to the new cap */
+    MeshDiskCache::instance().setMaxSize(size * megabyte);
+    appSettings().setValue("meshCache/maxSize", size * megabyte);
+    emit statusUpdateMessage(QString("Mesh cache limited to %1 MB").arg(size), 0);
+}
+
+void MainWindow::handleImportFailed(const QString &filePath)
+{
+    emit statusUpdateMessage(QString("Unable to open file: ") + filePath, 0);
+}
+
+void MainWindow::handleImportProgress(int completed, int total)
+{
+    Q_UNUSED(total);
+
+    if (importProgress)
+        importProgress->setValue(completed);
+}
+
+void MainWindow::handleImportFinished(bool cancelled)
+{
+    /* Add whatever arrived since the last batch, unless the import was cancelled */
+    if (cancelled)
+        discardImportedParts();
+    else
+        flushImportedParts();
+
+    if (importProgress)
+    {
+        /* Don't let closing the dialog cancel the next import */
+        disconnect(importProgress, &QProgressDialog::canceled, importer, &STLImporter::cancel);
+        importProgress->close();
+        importProgress->deleteLater();
+        importProgress = nullptr;
+    }
+    importFolder = QPersistentModelIndex();
+
+    if (cancelled)
+        emit statusUpdateMessage(QString("Folder Open Cancelled"), 0);
+    else
+        emit statusUpdateMessage(QString("Folder Loaded"), 0);
+
+}
+
 void MainWindow::openFile(const QString &filePath, QModelIndex &parentIndex)
 {
     QFile file(filePath);
@@ -330,40 +649,24 @@ void MainWindow::openFile(const QString &filePath, QModelIndex &parentIndex)
     QString visible("true");
     QColor colour(255, 255, 255);
 
-    /* Create a new blank item*/
-    ModelPart *newItem{};
+    /* Add the new item under the folder being opened, the selected item, or at the top level.
+     * The model creates the part so that its node is allocated in the model's store.
+     */
+    QModelIndex newIndex;
+    QList<QVariant> data = {fileName, visible, colour};
 
     /* Check if a parent index is provided (if a folder is opened) */
     if (parentIndex.isValid())
-    {
-        /* initialise the new item with the parent item's data*/
-        newItem = new ModelPart({fileName, visible, colour});
-        /* Get the parent item */
-        ModelPart *parentPart = static_cast<ModelPart *>(parentIndex.internalPointer());
-        /* Append the new item to the parent item */
-        parentPart->appendChild(newItem);
-    }
+        newIndex = partList->appendChild(parentIndex, data);
     /* Check if an item is selected (if a file is opened as a child) */
     else if (ui->treeView->selectionModel()->hasSelection())
-    {
-        /* If no parent index is provided but an item is selected, append the new item to the selected item */
-        QModelIndex selectedIndex = ui->treeView->currentIndex();
-        /* initialise the new item with the selected item's data */
-        newItem = new ModelPart({fileName, visible, colour});
-        /* Get the selected item */
-        ModelPart *selectedPart = static_cast<ModelPart *>(index.internalPointer());
-        /* Append the new item to the selected item */
-        selectedPart->appendChild(newItem);
-    }
+        newIndex = partList->appendChild(index, data);
     /* Check if no item is selected (if a file is opened as a top-level item) */
     else
-    {
-        /* If no parent index is provided and no item is selected, create a new top-level item */
-        QList<QVariant> data = {fileName, visible, colour};
-        QModelIndex newIndex = partList->appendChild(parentIndex, data);
-        /* Get the new item */
-        newItem = static_cast<ModelPart *>(newIndex.internalPointer());
-    }
+        newIndex = partList->appendChild(parentIndex, data);
+
+    /* Get the new item */
+    ModelPart *newItem = static_cast<ModelPart *>(newIndex.internalPointer());
 
     /* Update the tree view */
     partList->dataChanged(index, index);
@@ -371,11 +674,8 @@ void MainWindow::openFile(const QString &filePath, QModelIndex &parentIndex)
     /* Load the STL file */
     newItem->loadSTL(filePath);
 
-	/* Add actor to VR renderer */
-	vrThread->addActor(newItem->getVRActor(), newItem);
-
-    /* Add the actor to the map */
-    actorToModelPart[newItem->getActor()] = newItem;
+    /* Add the actor to the model's lookup, the scene adds it to the renderers */
+    partList->updateActor(newItem);
 }
 
 // -----------------------------------------------------------------------------------------------
@@ -443,85 +743,21 @@ void MainWindow::receiveDialogData(const QString &name, const bool &visible, con
     QModelIndex index = ui->treeView->currentIndex();
     ModelPart *selectedPart = static_cast<ModelPart *>(index.internalPointer());
 
-    /* Set the selected item's data */
-    selectedPart->setName(name);
-    selectedPart->setVisible(visible);
-    selectedPart->setColour(colour);
-
-    vrThread->issueCommand(VRRenderThread::SYNC_RENDER);
+    if (!selectedPart)
+        return;
 
-    updateRender();
+    /* Set the selected item's data through the model, so the scene only updates this part */
+    partList->setData(index.siblingAtColumn(0), name);
+    partList->setData(index.siblingAtColumn(1), visible);
+    partList->setData(index.siblingAtColumn(2), colour);
 }
 
 // -----------------------------------------------------------------------------------------------
 // Render Window
 
-void MainWindow::updateRender()
+void MainWindow::handleResetCamera()
 {
-    renderer->RemoveAllViewProps();
-    for (int i = 0; i < partList->rowCount(QModelIndex()); i++)
-    {
-        updateRenderFromTree(partList->index(i, 0, QModelIndex()));
-    }
-
-    /* Reset Camera */
-    renderer->ResetCamera();
-    renderer->ResetCameraClippingRange();
-    renderer->Render();
-}
-
-void MainWindow::updateRenderFromTree(const QModelIndex &index)
-{
-    if (index.isValid())
-    {
-        ModelPart *selectedPart = static_cast<ModelPart *>(index.internalPointer());
-        if (!selectedPart->isFolder())
-        {
-
-            /* Retrieve actor from selected part and add to renderer */
-            vtkSmartPointer<vtkActor> actor = selectedPart->getActor();
-            if (actor)
-            {
-                QColor qcolor = selectedPart->colour();
-                double red = qcolor.redF();
-                double green = qcolor.greenF();
-                double blue = qcolor.blueF();
-
-                /* Set the color of the actor */
-                actor->GetProperty()->SetColor(red, green, blue);
-
-                /* Check visibility and add or remove actor from renderer */
-                if (selectedPart->visible())
-                {
-                    if (!renderer->HasViewProp(actor))
-                    {
-                        renderer->AddActor(actor);
-
-                        vrThread->addActor(selectedPart->getVRActor(), selectedPart);
-                    }
-                }
-                else
-                {
-                    renderer->RemoveActor(actor);
-
-                    vrThread->removeActor(selectedPart->getVRActor());
-                }
-            }
-        }
-    }
-
-    /* Check to see if this part has any children */
-    if (!partList->hasChildren(index) || (index.flags() & Qt::ItemNeverHasChildren))
-    {
-        return;
-    }
-
-    /* Loop through children and add their actors */
-    int rows = partList->rowCount(index);
-    for (int i = 0; i < rows; i++)
-    {
-        updateRenderFromTree(partList->index(i, 0, index));
-    }
+    scene->resetCamera();
 }
 
 void MainWindow::onClick(vtkObject *caller, long unsigned int eventId, void *clientData, void *callData)
@@ -540,13 +776,14 @@ void MainWindow::onClick(vtkObject *caller, long unsigned int eventId, void *cli
             vtkActor *actor = picker->GetActor();
             if (actor)
             {
-                /* get the corresponding item */
-                ModelPart *selectedPart = actorToModelPart[actor];
-                emit statusUpdateMessage(QString("Clicked on: ") + selectedPart->name(), 0);
-                QModelIndex index = partList->index(selectedPart, QModelIndex());
+                /* get the corresponding item, both lookups are hash/array reads so picking
+                 * costs the same however big the tree is */
+                ModelPart *selectedPart = partList->partFromActor(actor);
+                QModelIndex index = partList->index(selectedPart);
                 /* select the corresponding item in the tree view */
                 if (index.isValid())
                 {
+                    emit statusUpdateMessage(QString("Clicked on: ") + selectedPart->name(), 0);
                     ui->treeView->setCurrentIndex(index);
                 }
             }
@@ -571,20 +808,92 @@ void MainWindow::on_actionStart_VR_triggered()
 
 	/* Actors should already be added to the VR renderer -> this is done when you open files */
 
-    /* Start the thread */
-    vrThread->start();
+    /* Start the thread, or wake it if VR was only paused */
+    vrThread->startRendering();
 }
 
 void MainWindow::on_actionStop_VR_triggered()
 {
     disconnect(ui->actionStop_VR, &QAction::triggered, this, &MainWindow::on_actionStop_VR_triggered);
     connect(ui->actionStart_VR, &QAction::triggered, this, &MainWindow::on_actionStart_VR_triggered);
-    emit statusUpdateMessage(QString("Stopping VR"), 0);
+    emit statusUpdateMessage(QString("Pausing VR"), 0);
+
+    /* The VR window and scene are kept, so starting again is quick */
     vrThread->issueCommand(VRRenderThread::END_RENDER);
 
     connect(ui->actionStop_VR, &QAction::triggered, this, &MainWindow::on_actionStop_VR_triggered);
 }
 
+void MainWindow::handleSimulateHeadsetToggled(bool checked)
+{
+    /* A paused session is closed by setBackend() */
+    if (vrThread->isRunning() && !vrThread->isPaused())
+    {
+        emit statusUpdateMessage(QString("Stop VR before changing the headset"), 0);
+        QSignalBlocker blocker(ui->actionSimulate_Headset);
+        ui->actionSimulate_Headset->setChecked(!checked);
+        return;
+    }
+
+    if (checked)
+        vrThread->setBackend(new SimulatedVRBackend());
+    else
+        vrThread->setBackend(new OpenVRBackend());
+}
+
+void MainWindow::handleFrameStats(const VRFrameSummary &summary)
+{
+    frameStatsLabel->setText(QString("VR frame p50 %1 ms  p95 %2 ms  p99 %3 ms  missed %4 (%5 total)")
+                                 .arg(summary.p50, 0, 'f', 1)
+                                 .arg(summary.p95, 0, 'f', 1)
+                                 .arg(summary.p99, 0, 'f', 1)
+                                 .arg(summary.missed)
+                                 .arg(summary.missedTotal));
+
+    /* Red once frames are being dropped */
+    frameStatsLabel->setStyleSheet(summary.missed > 0 ? "color: red" : "");
+}
+
+void MainWindow::handleVRFrameBudget()
+{
+    QSettings settings = appSettings();
+
+    bool ok = false;
+    double milliseconds = QInputDialog::getDouble(this, tr("VR Frame Budget"), tr("Time for queued changes per frame (ms):"),
+                                                  settings.value("vr/workBudget", defaultWorkBudget).toDouble(), 0.1, 11., 1, &ok);
+    if (!ok)
+        return;
+
+    int cells = QInputDialog::getInt(this, tr("VR Frame Budget"), tr("New geometry per frame (thousand cells):"),
+                                     int(settings.value("vr/uploadBudget", defaultUploadBudget).toLongLong() / 1000), 1, 100000, 50, &ok);
+    if (!ok)
+        return;
+
+    /* Both take effect on the next frame, even while VR is running */
+    vrThread->setWorkBudget(milliseconds);
+    vrThread->setUploadBudget(vtkIdType(cells) * 1000);
+    settings.setValue("vr/workBudget", milliseconds);
+    settings.setValue("vr/uploadBudget", qint64(cells) * 1000);
+    emit statusUpdateMessage(QString("VR frame budget: %1 ms and %2k cells per frame").arg(milliseconds).arg(cells), 0);
+}
+
+void MainWindow::handleSaveFrameTimings()
+{
+    QString filePath = QFileDialog::getSaveFileName(
+        this,
+        tr("Save Frame Timings"),
+        "frame_timings.csv",
+        tr("CSV Files(*.csv)"));
+
+    if (filePath.isEmpty())
+        return;
+
+    if (vrThread->dumpFrameStats(filePath))
+        emit statusUpdateMessage(QString("Frame timings saved: ") + filePath, 0);
+    else
+        emit statusUpdateMessage(QString("Could not write ") + filePath, 0);
+}
+
 void MainWindow::handleVRMessage(const QString& text)
 {
     // Show a message to the user
@@ -620,57 +929,224 @@ void MainWindow::onEndInteraction(vtkObject *caller, long unsigned int eventId,
 void MainWindow::on_actionClip_Filter_triggered()
 {
     disconnect(ui->actionClip_Filter, &QAction::triggered, this, &MainWindow::on_actionClip_Filter_triggered);
-    emit statusUpdateMessage(QString("Applying Clip Filter"), 0);
+    emit statusUpdateMessage(QString("Baking Section"), 0);
+
+    /* Cut the mesh for good where the section plane is now */
+    double origin[3];
+    double normal[3];
+    scene->sectionPlane(origin, normal);
+    pushFilter(PartFilter::clip(origin, normal));
+
+    connect(ui->actionClip_Filter, &QAction::triggered, this, &MainWindow::on_actionClip_Filter_triggered);
+}
+
+void MainWindow::on_actionShrink_Filter_triggered()
+
+{
+    disconnect(ui->actionShrink_Filter, &QAction::triggered, this, &MainWindow::on_actionShrink_Filter_triggered);
+
+    emit statusUpdateMessage(QString("Applying Shrink Filter"), 0);
+    pushFilter(PartFilter::shrink(0.5));
+
+    connect(ui->actionShrink_Filter, &QAction::triggered, this, &MainWindow::on_actionShrink_Filter_triggered);
+}
+
+void MainWindow::handleSectionView()
+{
     QModelIndex index = ui->treeView->currentIndex();
     ModelPart *selectedPart = static_cast<ModelPart *>(index.internalPointer());
-
     if (!selectedPart)
     {
         emit statusUpdateMessage(QString("No item selected"), 0);
+        return;
     }
-    else if (selectedPart->isFolder())
-	{
-		emit statusUpdateMessage(QString("Cannot apply filter to a folder"), 0);
-	}
-    else if (!vrThread->isRunning())
+
+    /* Works on folders too, everything below the item is toggled with it */
+    bool sectioned = !scene->isSectioned(selectedPart);
+    scene->setSectioned(index.siblingAtColumn(0), sectioned);
+    emit statusUpdateMessage(selectedPart->name() + (sectioned ? QString(" shown in section") : QString(" section removed")), 0);
+}
+
+void MainWindow::handleSectionMoved(int value)
+{
+    scene->setSectionPosition(value / 1000.);
+}
+
+void MainWindow::handleDecimateFilter()
+{
+    emit statusUpdateMessage(QString("Applying Decimate Filter"), 0);
+    pushFilter(PartFilter::decimate(0.5));
+}
+
+void MainWindow::handleSmoothFilter()
+{
+    emit statusUpdateMessage(QString("Applying Smooth Filter"), 0);
+    pushFilter(PartFilter::smooth(20, 0.1));
+}
+
+void MainWindow::handleEditFilter()
+{
+    ModelPart *selectedPart = selectedFilterPart();
+    if (!selectedPart)
+        return;
+
+    if (selectedPart->filters().empty())
     {
-        emit statusUpdateMessage(QString("VR not running"), 0);
+        emit statusUpdateMessage(QString("No filters to edit"), 0);
+        return;
     }
-    else
+
+    /* Pick the stage, the stages before it keep their cached results */
+    QStringList stages;
+    for (std::size_t i = 0; i < selectedPart->filters().size(); i++)
+        stages.append(QString("%1. %2").arg(i + 1).arg(selectedPart->filters()[i].describe()));
+
+    bool ok = false;
+    QString chosen = QInputDialog::getItem(this, tr("Edit Filter"), tr("Stage:"), stages, stages.size() - 1, false, &ok);
+    if (!ok)
+        return;
+    int stage = stages.indexOf(chosen);
+
+    PartFilter filter = selectedPart->filters()[stage];
+    switch (filter.type)
+    {
+    case PartFilter::Shrink:
+        filter = PartFilter::shrink(QInputDialog::getDouble(this, tr("Edit Filter"), tr("Shrink factor:"),
+                                                            filter.parameters[0], 0.01, 1., 2, &ok));
+        break;
+
+    case PartFilter::Clip:
     {
-        vrThread->applyClipFilter(selectedPart);
-        emit statusUpdateMessage(QString("Clip Filter Applied"), 0);
+        /* Cut where the section plane is now, as Bake Section does */
+        ok = QMessageBox::question(this, tr("Edit Filter"), tr("Move the clip to the section plane?")) == QMessageBox::Yes;
+        double origin[3];
+        double normal[3];
+        scene->sectionPlane(origin, normal);
+        filter = PartFilter::clip(origin, normal);
+        break;
     }
 
-    connect(ui->actionClip_Filter, &QAction::triggered, this, &MainWindow::on_actionClip_Filter_triggered);
+    case PartFilter::Decimate:
+        filter = PartFilter::decimate(QInputDialog::getDouble(this, tr("Edit Filter"), tr("Fraction of triangles to remove:"),
+                                                              filter.parameters[0], 0., 0.99, 2, &ok));
+        break;
+
+    case PartFilter::Smooth:
+    {
+        int iterations = QInputDialog::getInt(this, tr("Edit Filter"), tr("Iterations:"),
+                                              int(filter.parameters[0]), 1, 1000, 1, &ok);
+        if (!ok)
+            return;
+        double relaxation = QInputDialog::getDouble(this, tr("Edit Filter"), tr("Relaxation factor:"),
+                                                    filter.parameters[1], 0.01, 1., 2, &ok);
+        filter = PartFilter::smooth(iterations, relaxation);
+        break;
+    }
+    }
+    if (!ok)
+        return;
+
+    /* Only this stage and the ones after it are run again */
+    selectedPart->setFilter(stage, filter);
+    applyFilters(selectedPart);
 }
 
-void MainWindow::on_actionShrink_Filter_triggered()
+void MainWindow::handleRemoveLastFilter()
+{
+    ModelPart *selectedPart = selectedFilterPart();
+    if (!selectedPart)
+        return;
 
+    if (!selectedPart->popFilter())
+    {
+        emit statusUpdateMessage(QString("No filters to remove"), 0);
+        return;
+    }
+    applyFilters(selectedPart);
+}
+
+void MainWindow::handleClearFilters()
 {
-    disconnect(ui->actionShrink_Filter, &QAction::triggered, this, &MainWindow::on_actionShrink_Filter_triggered);
+    ModelPart *selectedPart = selectedFilterPart();
+    if (!selectedPart)
+        return;
 
-    emit statusUpdateMessage(QString("Applying Clip Filter"), 0);
+    selectedPart->clearFilters();
+    applyFilters(selectedPart);
+}
+
+ModelPart *MainWindow::selectedFilterPart()
+{
     QModelIndex index = ui->treeView->currentIndex();
     ModelPart *selectedPart = static_cast<ModelPart *>(index.internalPointer());
 
     if (!selectedPart)
     {
         emit statusUpdateMessage(QString("No item selected"), 0);
+        return nullptr;
     }
-	else if (selectedPart->isFolder())
-	{
-		emit statusUpdateMessage(QString("Cannot apply filter to a folder"), 0);
-	}
-    else if (!vrThread->isRunning())
+    if (selectedPart->isFolder())
     {
-        emit statusUpdateMessage(QString("VR not running"), 0);
+        emit statusUpdateMessage(QString("Cannot apply filter to a folder"), 0);
+        return nullptr;
     }
-    else
+    return selectedPart;
+}
+
+void MainWindow::pushFilter(const PartFilter &filter)
+{
+    ModelPart *selectedPart = selectedFilterPart();
+    if (!selectedPart)
+        return;
+
+    if (!selectedPart->isResident())
     {
-        vrThread->applyShrinkFilter(selectedPart);
-        emit statusUpdateMessage(QString("Clip Filter Applied"), 0);
+        emit statusUpdateMessage(QString("Part not loaded yet"), 0);
+        return;
     }
 
-    connect(ui->actionShrink_Filter, &QAction::triggered, this, &MainWindow::on_actionShrink_Filter_triggered);
-}
\ No newline at end of file
+    selectedPart->pushFilter(filter);
+    applyFilters(selectedPart);
+}
+
+void MainWindow::applyFilters(ModelPart *part)
+{
+    /* Only the stages after the last one that is already cached are run */
+    if (!filterRunner->applyFilters(part))
+    {
+        emit statusUpdateMessage(QString("Part not loaded yet"), 0);
+        return;
+    }
+
+    QStringList stages;
+    for (const PartFilter &filter : part->filters())
+        stages.append(filter.describe());
+    emit statusUpdateMessage(part->name() + QString(" filters: ") + (stages.isEmpty() ? QString("none") : stages.join(", ")), 0);
+}
+
+void MainWindow::clearAllFilters(ModelPart *item)
+{
+    item->clearFilters();
+    for (int i = 0; i < item->childCount(); i++)
+        clearAllFilters(item->child(i));
+}
+
+void MainWindow::handleFilterFinished(vtkSmartPointer<vtkActor> actor, vtkSmartPointer<vtkPolyData> output)
+{
+    vrThread->setFilteredInput(actor, output);
+
+    /* Show how well the filter cache is doing */
+    FilterCache &cache = FilterCache::instance();
+    qint64 lookups = cache.hitCount() + cache.missCount();
+    int hitRate = lookups > 0 ? int(cache.hitCount() * 100 / lookups) : 0;
+    emit statusUpdateMessage(QString("Filter Applied (filter cache: %1% hits, %2 results, %3 MB)")
+                                 .arg(hitRate)
+                                 .arg(cache.entryCount())
+                                 .arg(cache.memoryUsed() >> 20),
+                             0);
+}
+
+void MainWindow::handleFilterProgress(int percent)
+{
+    emit statusUpdateMessage(QString("Filtering... %1%").arg(percent), 0);
+}
@@ -27,8 +27,15 @@
 #include <vtkPropPicker.h>
 #include <vtkCallbackCommand.h>
 #include "VRRenderThread.h"
+#include "STLImporter.h"
+#include "FilterRunner.h"
+#include "RenderScene.h"
 #include <vtkRendererCollection.h>
 #include <QMutex>
+#include <QMultiHash>
+#include <QTimer>
+#include <QLabel>
+#include <QPair>
 #include <vtkLight.h>
 #include <vtkTexture.h>
 #include <vtkJPEGReader.h>
@@ -78,17 +85,6 @@ public:
      */
     void openFile(const QString &fileName, QModelIndex &parentIndex);
 
-    /**
-     * @brief Updates the render window.
-     */
-    void updateRender();
-
-    /**
-     * @brief Updates the render window from the tree.
-     * @param index The index of the tree.
-     */
-    void updateRenderFromTree(const QModelIndex &index);
-
     /**
      * @brief function called when an actor is clicked.
      * @param caller The caller object.
@@ -107,6 +103,12 @@ public:
      */
     void onEndInteraction(vtkObject *caller, long unsigned int eventId, void *clientData, void *callData);
 
+    /**
+     * @brief Starts loading the geometry of a placeholder part in the background.
+     * @param index The index of the part. Nothing happens if it is already loaded or loading.
+     */
+    void requestPartLoad(const QModelIndex &index);
+
 signals:
     /**
      * @brief Emits a status update message.
@@ -193,7 +195,179 @@ public slots:
      */
 	void handleVRMessage(const QString& text);
 
+    /**
+     * @brief Queues a part loaded by a folder import to be added to the tree.
+     * @param filePath The path of the file.
+     * @param mesh The mesh read from the file.
+     */
+    void handleImportedPart(const QString &filePath, const PartMesh &mesh);
+
+    /**
+     * @brief Queues a placeholder part for a file whose header was read by a lazy import.
+     * @param filePath The path of the file.
+     * @param header The triangle count and bounds of the file.
+     */
+    void handleImportedHeader(const QString &filePath, const PartHeader &header);
+
+    /**
+     * @brief Adds the queued parts and placeholders to the import folder with one insertion each.
+     */
+    void flushImportedParts();
+
+    /**
+     * @brief Reports a file the import could not read.
+     * @param filePath The path of the file.
+     */
+    void handleImportFailed(const QString &filePath);
+
+    /**
+     * @brief Updates the import progress dialog.
+     * @param completed The number of files done.
+     * @param total The number of files in the import.
+     */
+    void handleImportProgress(int completed, int total);
+
+    /**
+     * @brief Closes the progress dialog once the import has finished or been cancelled.
+     * @param cancelled True if the import was cancelled.
+     */
+    void handleImportFinished(bool cancelled);
+
+    /**
+     * @brief Swaps the placeholders waiting for a file for the loaded geometry.
+     * @param filePath The path of the file.
+     * @param mesh The mesh read from the file.
+     */
+    void handleOnDemandPart(const QString &filePath, const PartMesh &mesh);
+
+    /**
+     * @brief Loads the geometry of a placeholder part when it is selected.
+     * @param current The newly selected index.
+     */
+    void handleCurrentChanged(const QModelIndex &current);
+
+    /**
+     * @brief Switches folder imports between loading everything and loading parts on demand.
+     * @param checked True to load parts on demand.
+     */
+    void handleLoadOnDemandToggled(bool checked);
+
+    /**
+     * @brief Asks for the folder preprocessed meshes are cached in and remembers it.
+     */
+    void handleMeshCacheFolder();
+
+    /**
+     * @brief Asks for the size cap of the mesh cache and remembers it.
+     */
+    void handleMeshCacheSize();
+
+    /**
+     * @brief Frames every part in the render window.
+     */
+    void handleResetCamera();
+
+    /**
+     * @brief Switches VR between the headset and an offscreen stand-in for it.
+     * @param checked True to use the stand-in.
+     */
+    void handleSimulateHeadsetToggled(bool checked);
+
+    /**
+     * @brief Shows the latest VR frame times in the status bar.
+     * @param summary Frame time percentiles and missed frames.
+     */
+    void handleFrameStats(const VRFrameSummary &summary);
+
+    /**
+     * @brief Saves the timings of the recent VR frames to a CSV file.
+     */
+    void handleSaveFrameTimings();
+
+    /**
+     * @brief Asks for the VR loop's per-frame budget for queued work and saves it for the next run.
+     */
+    void handleVRFrameBudget();
+
+    /**
+     * @brief Shows the selected part or folder in section, or takes the section off.
+     */
+    void handleSectionView();
+
+    /**
+     * @brief Moves the section plane.
+     * @param value The slider position, 0 to 1000 across the scene.
+     */
+    void handleSectionMoved(int value);
+
+    /**
+     * @brief Adds a decimate filter to the selected part.
+     */
+    void handleDecimateFilter();
+
+    /**
+     * @brief Adds a smooth filter to the selected part.
+     */
+    void handleSmoothFilter();
+
+    /**
+     * @brief Changes the parameters of one filter in the selected part's stack and runs it again.
+     */
+    void handleEditFilter();
+
+    /**
+     * @brief Takes the last filter off the selected part.
+     */
+    void handleRemoveLastFilter();
+
+    /**
+     * @brief Takes every filter off the selected part, leaving the rest of the scene alone.
+     */
+    void handleClearFilters();
+
+    /**
+     * @brief Shows a finished filter in VR.
+     * @param actor The VR actor of the filtered part.
+     * @param output The filtered mesh.
+     */
+    void handleFilterFinished(vtkSmartPointer<vtkActor> actor, vtkSmartPointer<vtkPolyData> output);
+
+    /**
+     * @brief Shows the progress of the running filter in the status bar.
+     * @param percent How much of the filter is done.
+     */
+    void handleFilterProgress(int percent);
+
 private:
+    /**
+     * @brief Gets the selected part if filters can be applied to it.
+     * @return The part, or null (with a status message) if nothing suitable is selected.
+     */
+    ModelPart *selectedFilterPart();
+
+    /**
+     * @brief Adds a filter to the end of the selected part's stack and runs it.
+     * @param filter The filter to add.
+     */
+    void pushFilter(const PartFilter &filter);
+
+    /**
+     * @brief Shows a part's filter stack in VR once it has run.
+     * @param part The part whose stack changed.
+     */
+    void applyFilters(ModelPart *part);
+
+    /**
+     * @brief Empties the filter stacks of an item and everything under it.
+     * @param item The item to start from.
+     */
+    void clearAllFilters(ModelPart *item);
+
+    /**
+     * @brief Drops the parts and placeholders the running import has queued, and their unclaimed meshes.
+     */
+    void discardImportedParts();
+
     /**
      * @brief The renderer object.
      */
@@ -204,11 +378,6 @@ private:
      */
     vtkSmartPointer<vtkGenericOpenGLRenderWindow> renderWindow;
 
-    /**
-     * @brief An actor to model part map
-     */
-    std::unordered_map<vtkActor *, ModelPart *> actorToModelPart;
-
     /**
      * @brief ui object
      */
@@ -224,6 +393,56 @@ private:
      */
     VRRenderThread *vrThread;
 
+    /**
+     * @brief Adds, removes and updates actors as the tree changes.
+     */
+    RenderScene *scene;
+
+    /**
+     * @brief Loads folders of STL files in the background.
+     */
+    STLImporter *importer;
+
+    /**
+     * @brief Runs the shrink and clip filters in the background.
+     */
+    FilterRunner *filterRunner;
+
+    /**
+     * @brief VR frame times, kept at the right of the status bar.
+     */
+    QLabel *frameStatsLabel;
+
+    /**
+     * @brief Progress dialog for the running import (null if no import is running).
+     */
+    QProgressDialog *importProgress;
+
+    /**
+     * @brief The folder item the running import adds its parts to.
+     */
+    QPersistentModelIndex importFolder;
+
+    /**
+     * @brief Parts loaded by the running import that haven't been added to the tree yet.
+     */
+    QList<QPair<QString, PartMesh>> importedParts;
+
+    /**
+     * @brief Placeholders from the running import that haven't been added to the tree yet.
+     */
+    QList<QPair<QString, PartHeader>> importedHeaders;
+
+    /**
+     * @brief Adds the queued parts to the tree shortly after the first one arrives.
+     */
+    QTimer *importFlushTimer;
+
+    /**
+     * @brief Placeholder parts waiting for their file to be loaded, by file path.
+     */
+    QMultiHash<QString, QPersistentModelIndex> pendingLoads;
+
     /**
      * @brief The previous orientation.
      */